@@ -35,6 +35,7 @@
 #include <JuceHeader.h>
 #include "UI/MainHostWindow.h"
 #include "Plugins/InternalPlugins.h"
+#include "Plugins/PluginDescriptionCodec.h"
 
 #if ! (JUCE_PLUGINHOST_VST || JUCE_PLUGINHOST_VST3 || JUCE_PLUGINHOST_AU)
  #error "If you're building the audio plugin host, you probably want to enable VST and/or AU support"
@@ -72,7 +73,10 @@ private:
 
     void handleConnectionLost() override
     {
-        JUCEApplicationBase::quit();
+        // This arrives on the connection or ping thread. The host gives up on a scan that takes
+        // too long by dropping the connection, and by then the message thread may well be stuck
+        // inside the plug-in, so asking the app to quit would never get anywhere.
+        Process::terminate();
     }
 
     void handleAsyncUpdate() override
@@ -122,13 +126,7 @@ private:
 
     void sendResults (const OwnedArray<PluginDescription>& results)
     {
-        XmlElement xml ("LIST");
-
-        for (const auto& desc : results)
-            xml.addChildElement (desc->createXml().release());
-
-        const auto str = xml.toString();
-        sendMessageToCoordinator ({ str.toRawUTF8(), str.getNumBytesAsUTF8() });
+        sendMessageToCoordinator (PluginDescriptionCodec::encode (results));
     }
 
     std::mutex mutex;
@@ -209,7 +207,7 @@ public:
         if (fileToOpen.existsAsFile())
             if (auto* graph = mainWindow->graphHolder.get())
                 if (auto* ioGraph = graph->graph.get())
-                    ioGraph->loadFrom (fileToOpen, true);
+                    ioGraph->loadFromAsync (fileToOpen, true, [] (Result) {});
     }
 
     void shutdown() override
@@ -0,0 +1,205 @@
+#include <JuceHeader.h>
+#include "FilterGraphFile.h"
+
+static constexpr char binaryMagic[4] = { 'F', 'G', 'R', 'B' };
+
+// states smaller than this aren't worth inflating again when loading
+static constexpr size_t minSizeToCompress = 4096;
+
+//==============================================================================
+FilterGraphStateBlobs::FilterGraphStateBlobs (const File& file, std::vector<Entry> entries)
+    : mappedFile (std::make_unique<MemoryMappedFile> (file, MemoryMappedFile::readOnly)),
+      index (std::move (entries))
+{
+    if (mappedFile->getData() == nullptr)
+    {
+        mappedFile = nullptr;
+        file.loadFileAsData (fallbackData);
+    }
+}
+
+const void* FilterGraphStateBlobs::getData() const noexcept
+{
+    return mappedFile != nullptr ? mappedFile->getData() : fallbackData.getData();
+}
+
+int64 FilterGraphStateBlobs::getSize() const noexcept
+{
+    return mappedFile != nullptr ? (int64) mappedFile->getSize() : (int64) fallbackData.getSize();
+}
+
+MemoryBlock FilterGraphStateBlobs::getState (int blobIndex) const
+{
+    if (! isPositiveAndBelow (blobIndex, getNumStates()))
+        return {};
+
+    const auto& entry = index[(size_t) blobIndex];
+
+    if (entry.offset < 0 || entry.storedSize < 0 || entry.offset + entry.storedSize > getSize())
+    {
+        jassertfalse;   // the file has been truncated or changed since it was opened
+        return {};
+    }
+
+    const auto* stored = static_cast<const char*> (getData()) + entry.offset;
+
+    if (entry.encoding == Encoding::raw)
+        return { stored, (size_t) entry.storedSize };
+
+    MemoryInputStream compressed (stored, (size_t) entry.storedSize, false);
+    GZIPDecompressorInputStream decompressor (&compressed, false, GZIPDecompressorInputStream::zlibFormat, entry.size);
+
+    MemoryBlock state;
+    decompressor.readIntoMemoryBlock (state);
+    return state;
+}
+
+//==============================================================================
+bool FilterGraphFile::isBinary (const File& file)
+{
+    FileInputStream in (file);
+    char magic[4] = {};
+
+    return in.openedOk() && in.read (magic, 4) == 4 && std::memcmp (magic, binaryMagic, 4) == 0;
+}
+
+FilterGraphFile::Document FilterGraphFile::read (const File& file, String& errorMessage)
+{
+    if (isBinary (file))
+        return readBinary (file, errorMessage);
+
+    Document document;
+    document.xml = parseXMLIfTagMatches (file, "FILTERGRAPH");
+
+    if (document.xml == nullptr)
+        errorMessage = "Not a valid graph file";
+
+    return document;
+}
+
+FilterGraphFile::Document FilterGraphFile::readBinary (const File& file, String& errorMessage)
+{
+    FileInputStream in (file);
+    in.skipNextBytes (4);
+
+    const auto fail = [&errorMessage] (const String& message)
+    {
+        errorMessage = message;
+        return Document{};
+    };
+
+    if (const auto version = in.readInt(); version != binaryVersion)
+        return fail ("Unsupported graph file version " + String (version));
+
+    const auto structureSize = in.readInt64();
+
+    if (structureSize <= 0 || structureSize > in.getNumBytesRemaining())
+        return fail ("The graph file is damaged");
+
+    MemoryBlock structure;
+    in.readIntoMemoryBlock (structure, (ssize_t) structureSize);
+
+    Document document;
+    document.xml = parseXMLIfTagMatches (structure.toString(), "FILTERGRAPH");
+
+    if (document.xml == nullptr)
+        return fail ("Not a valid graph file");
+
+    const auto numBlobs = in.readInt();
+
+    if (numBlobs < 0 || (int64) numBlobs * 28 > in.getNumBytesRemaining())
+        return fail ("The graph file is damaged");
+
+    std::vector<FilterGraphStateBlobs::Entry> index ((size_t) numBlobs);
+
+    for (auto& entry : index)
+    {
+        entry.offset     = in.readInt64();
+        entry.storedSize = in.readInt64();
+        entry.size       = in.readInt64();
+        entry.encoding   = (FilterGraphStateBlobs::Encoding) in.readInt();
+
+        if (entry.offset < 0 || entry.storedSize < 0 || entry.offset + entry.storedSize > in.getTotalLength())
+            return fail ("The graph file is damaged");
+    }
+
+    document.blobs.reset (new FilterGraphStateBlobs (file, std::move (index)));
+    return document;
+}
+
+//==============================================================================
+Result FilterGraphFile::writeBinary (const File& file, const XmlElement& structure, const std::vector<MemoryBlock>& states)
+{
+    const auto structureText = structure.toString (XmlElement::TextFormat().singleLine().withoutHeader());
+    const auto structureSize = (int64) structureText.getNumBytesAsUTF8();
+
+    std::vector<FilterGraphStateBlobs::Entry> index (states.size());
+    std::vector<MemoryBlock> compressed (states.size());
+
+    auto offset = (int64) sizeof (binaryMagic) + 4 + 8 + structureSize + 4 + (int64) states.size() * 28;
+
+    for (size_t i = 0; i < states.size(); ++i)
+    {
+        auto& entry = index[i];
+        entry.size = (int64) states[i].getSize();
+        entry.storedSize = entry.size;
+
+        // only keep the compressed copy if it saves at least an eighth
+        if (states[i].getSize() >= minSizeToCompress)
+        {
+            {
+                MemoryOutputStream out (compressed[i], false);
+                GZIPCompressorOutputStream deflater (out, 1);
+                deflater.write (states[i].getData(), states[i].getSize());
+            }
+
+            if ((int64) compressed[i].getSize() < entry.size - entry.size / 8)
+            {
+                entry.encoding = FilterGraphStateBlobs::Encoding::deflate;
+                entry.storedSize = (int64) compressed[i].getSize();
+            }
+        }
+
+        entry.offset = offset;
+        offset += entry.storedSize;
+    }
+
+    TemporaryFile temp (file);
+
+    {
+        FileOutputStream out (temp.getFile());
+
+        if (! out.openedOk())
+            return Result::fail ("Couldn't write to the file");
+
+        out.write (binaryMagic, sizeof (binaryMagic));
+        out.writeInt (binaryVersion);
+        out.writeInt64 (structureSize);
+        out.write (structureText.toRawUTF8(), (size_t) structureSize);
+        out.writeInt ((int) index.size());
+
+        for (auto& entry : index)
+        {
+            out.writeInt64 (entry.offset);
+            out.writeInt64 (entry.storedSize);
+            out.writeInt64 (entry.size);
+            out.writeInt ((int) entry.encoding);
+        }
+
+        for (size_t i = 0; i < states.size(); ++i)
+        {
+            const auto& blob = index[i].encoding == FilterGraphStateBlobs::Encoding::deflate ? compressed[i] : states[i];
+            out.write (blob.getData(), blob.getSize());
+        }
+
+        out.flush();
+
+        if (out.getStatus().failed())
+            return Result::fail ("Couldn't write to the file");
+    }
+
+    if (! temp.overwriteTargetFileWithTemporary())
+        return Result::fail ("Couldn't write to the file");
+
+    return Result::ok();
+}
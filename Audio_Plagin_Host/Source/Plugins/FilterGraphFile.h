@@ -0,0 +1,81 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/**
+    The plug-in states of a binary .filtergraph, decoded one at a time when a
+    node asks for its own.
+
+    The file is memory-mapped, so opening a document only reads its structure
+    and index; getState() may be called from any thread.
+*/
+class FilterGraphStateBlobs final
+{
+public:
+    enum class Encoding : int32 { raw = 0, deflate = 1 };
+
+    struct Entry
+    {
+        int64 offset = 0, storedSize = 0, size = 0;
+        Encoding encoding = Encoding::raw;
+    };
+
+    int getNumStates() const noexcept                   { return (int) index.size(); }
+    MemoryBlock getState (int blobIndex) const;
+
+private:
+    friend class FilterGraphFile;
+
+    FilterGraphStateBlobs (const File&, std::vector<Entry>);
+
+    const void* getData() const noexcept;
+    int64 getSize() const noexcept;
+
+    std::unique_ptr<MemoryMappedFile> mappedFile;
+    MemoryBlock fallbackData;                           // used if the file can't be mapped
+    const std::vector<Entry> index;
+};
+
+//==============================================================================
+/**
+    Reads and writes .filtergraph documents in either format.
+
+    The XML format embeds each plug-in's state as base64 inside its FILTER
+    element. The binary format is a container of chunks:
+
+        "FGRB", int32 version
+        int64 size, then the graph's structure as single-line UTF-8 XML, in
+            which each STATE element only holds the number of its blob
+        int32 number of blobs, then one index entry per blob:
+            int64 offset from the start of the file, int64 stored size,
+            int64 decoded size, int32 encoding
+        the blobs, raw or deflated
+
+    so loading never has to parse or decode a state the graph doesn't use yet.
+    All numbers are little-endian.
+*/
+class FilterGraphFile final
+{
+public:
+    struct Document
+    {
+        std::unique_ptr<XmlElement> xml;                        // FILTERGRAPH
+        std::shared_ptr<const FilterGraphStateBlobs> blobs;     // only for binary documents
+    };
+
+    static constexpr int32 binaryVersion = 1;
+
+    static bool isBinary (const File&);
+
+    /** Reads either format; the Document's xml is null if the file isn't a graph. */
+    static Document read (const File&, String& errorMessage);
+
+    /** Writes a FILTERGRAPH element whose STATE elements have been replaced by blob numbers,
+        one per entry in states.
+    */
+    static Result writeBinary (const File&, const XmlElement& structure, const std::vector<MemoryBlock>& states);
+
+private:
+    static Document readBinary (const File&, String& errorMessage);
+};
@@ -0,0 +1,474 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE framework.
+   Copyright (c) Raw Material Software Limited
+
+   JUCE is an open source framework subject to commercial or open source
+   licensing.
+
+   By downloading, installing, or using the JUCE framework, or combining the
+   JUCE framework with any other source code, object code, content or any other
+   copyrightable work, you agree to the terms of the JUCE End User Licence
+   Agreement, and all incorporated terms including the JUCE Privacy Policy and
+   the JUCE Website Terms of Service, as applicable, which will bind you. If you
+   do not agree to the terms of these agreements, we will not license the JUCE
+   framework to you, and you must discontinue the installation or download
+   process and cease use of the JUCE framework.
+
+   JUCE End User Licence Agreement: https://juce.com/legal/juce-8-licence/
+   JUCE Privacy Policy: https://juce.com/juce-privacy-policy
+   JUCE Website Terms of Service: https://juce.com/juce-website-terms-of-service/
+
+   Or:
+
+   You may also use this code under the terms of the AGPLv3:
+   https://www.gnu.org/licenses/agpl-3.0.en.html
+
+   THE JUCE FRAMEWORK IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL
+   WARRANTIES, WHETHER EXPRESSED OR IMPLIED, INCLUDING WARRANTY OF
+   MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE, ARE DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "FilterGraphLoader.h"
+#include "ARAPlugin.h"
+
+//==============================================================================
+static void readBusLayoutFromXml (AudioProcessor::BusesLayout& busesLayout, AudioProcessor& plugin,
+                                  const XmlElement& xml, bool isInput)
+{
+    auto& targetBuses = (isInput ? busesLayout.inputBuses
+                                 : busesLayout.outputBuses);
+    int maxNumBuses = 0;
+
+    if (auto* buses = xml.getChildByName (isInput ? "INPUTS" : "OUTPUTS"))
+    {
+        for (auto* e : buses->getChildWithTagNameIterator ("BUS"))
+        {
+            const int busIdx = e->getIntAttribute ("index");
+            maxNumBuses = jmax (maxNumBuses, busIdx + 1);
+
+            // the number of buses on busesLayout may not be in sync with the plugin after adding buses
+            // because adding an input bus could also add an output bus
+            for (int actualIdx = plugin.getBusCount (isInput) - 1; actualIdx < busIdx; ++actualIdx)
+                if (! plugin.addBus (isInput))
+                    return;
+
+            for (int actualIdx = targetBuses.size() - 1; actualIdx < busIdx; ++actualIdx)
+                targetBuses.add (plugin.getChannelLayoutOfBus (isInput, busIdx));
+
+            auto layout = e->getStringAttribute ("layout");
+
+            if (layout.isNotEmpty())
+                targetBuses.getReference (busIdx) = AudioChannelSet::fromAbbreviatedString (layout);
+        }
+    }
+
+    // if the plugin has more buses than specified in the xml, then try to remove them!
+    while (maxNumBuses < targetBuses.size())
+    {
+        if (! plugin.removeBus (isInput))
+            return;
+
+        targetBuses.removeLast();
+    }
+}
+
+//==============================================================================
+static std::unique_ptr<AudioPluginInstance> wrapForARA (std::unique_ptr<AudioPluginInstance> instance,
+                                                        [[maybe_unused]] const PluginDescriptionAndPreference& description)
+{
+   #if JUCE_PLUGINHOST_ARA && (JUCE_MAC || JUCE_WINDOWS || JUCE_LINUX)
+    if (instance
+        && description.useARA == PluginDescriptionAndPreference::UseARA::yes
+        && description.pluginDescription.hasARAExtension)
+    {
+        return std::make_unique<ARAPluginInstanceWrapper> (std::move (instance));
+    }
+   #endif
+
+    return instance;
+}
+
+//==============================================================================
+FilterGraphLoader::FilterGraphLoader (AudioPluginFormatManager& fm, KnownPluginList& kpl)
+    : formatManager (fm),
+      knownPlugins (kpl)
+{
+    knownPlugins.addChangeListener (this);
+}
+
+FilterGraphLoader::~FilterGraphLoader()
+{
+    knownPlugins.removeChangeListener (this);
+}
+
+void FilterGraphLoader::changeListenerCallback (ChangeBroadcaster*)
+{
+    const ScopedLock sl (fallbackLock);
+    fallbackIndex.reset();
+}
+
+static String makeFallbackKey (const String& formatName, int uniqueId)
+{
+    return formatName + ":" + String (uniqueId);
+}
+
+PluginDescriptionAndPreference FilterGraphLoader::getDescription (const XmlElement& xml)
+{
+    PluginDescriptionAndPreference pd;
+    const auto nodeUsesARA = xml.getBoolAttribute ("useARA");
+
+    for (auto* e : xml.getChildIterator())
+    {
+        if (pd.pluginDescription.loadFromXml (*e))
+        {
+            pd.useARA = nodeUsesARA ? PluginDescriptionAndPreference::UseARA::yes
+                                    : PluginDescriptionAndPreference::UseARA::no;
+            break;
+        }
+    }
+
+    return pd;
+}
+
+MemoryBlock FilterGraphLoader::getState (const XmlElement& xml, const FilterGraphStateBlobs* blobs)
+{
+    MemoryBlock m;
+
+    if (auto* state = xml.getChildByName ("STATE"))
+    {
+        if (state->hasAttribute ("blob"))
+        {
+            jassert (blobs != nullptr);
+
+            if (blobs != nullptr)
+                m = blobs->getState (state->getIntAttribute ("blob", -1));
+        }
+        else
+        {
+            m.fromBase64Encoding (state->getAllSubText());
+        }
+    }
+
+    return m;
+}
+
+AudioPluginFormat* FilterGraphLoader::findFormat (const PluginDescription& description) const
+{
+    for (auto* format : formatManager.getFormats())
+        if (format->getName() == description.pluginFormatName)
+            return format;
+
+    return nullptr;
+}
+
+std::optional<PluginDescriptionAndPreference> FilterGraphLoader::findKnownFallback (const PluginDescriptionAndPreference& pd) const
+{
+    if (findFormat (pd.pluginDescription) == nullptr)
+        return {};
+
+    const ScopedLock sl (fallbackLock);
+
+    if (! fallbackIndex.has_value())
+    {
+        fallbackIndex.emplace();
+
+        for (const auto& desc : knownPlugins.getTypes())
+            fallbackIndex->emplace (makeFallbackKey (desc.pluginFormatName, desc.uniqueId), desc);
+    }
+
+    const auto found = fallbackIndex->find (makeFallbackKey (pd.pluginDescription.pluginFormatName,
+                                                             pd.pluginDescription.uniqueId));
+
+    if (found == fallbackIndex->end())
+        return {};
+
+    return PluginDescriptionAndPreference { found->second };
+}
+
+std::unique_ptr<AudioPluginInstance> FilterGraphLoader::createInstance (const PluginDescriptionAndPreference& pd,
+                                                                        double sampleRate, int blockSize,
+                                                                        String& errorMessage) const
+{
+    auto createInstance = [&] (const PluginDescriptionAndPreference& description)
+    {
+        auto localDpiDisabler = makeDPIAwarenessDisabler != nullptr ? makeDPIAwarenessDisabler (description.pluginDescription)
+                                                                    : nullptr;
+
+        return wrapForARA (formatManager.createPluginInstance (description.pluginDescription,
+                                                               sampleRate,
+                                                               blockSize,
+                                                               errorMessage),
+                           description);
+    };
+
+    if (auto instance = createInstance (pd))
+        return instance;
+
+    if (auto fallback = findKnownFallback (pd))
+        return createInstance (*fallback);
+
+    return nullptr;
+}
+
+void FilterGraphLoader::createInstanceAsync (const PluginDescriptionAndPreference& pd,
+                                             double sampleRate, int blockSize,
+                                             InstanceCallback callback) const
+{
+    auto create = [this, sampleRate, blockSize] (const PluginDescriptionAndPreference& description,
+                                                 AudioPluginFormat::PluginCreationCallback onCreated)
+    {
+        std::shared_ptr<ScopedDPIAwarenessDisabler> dpiDisabler;
+
+        if (makeDPIAwarenessDisabler != nullptr)
+            dpiDisabler = makeDPIAwarenessDisabler (description.pluginDescription);
+
+        formatManager.createPluginInstanceAsync (description.pluginDescription, sampleRate, blockSize,
+                                                 [dpiDisabler, description, onCreated = std::move (onCreated)]
+                                                 (std::unique_ptr<AudioPluginInstance> instance, const String& error)
+                                                 {
+                                                     onCreated (wrapForARA (std::move (instance), description), error);
+                                                 });
+    };
+
+    create (pd, [create, fallback = findKnownFallback (pd), callback = std::move (callback)]
+                (std::unique_ptr<AudioPluginInstance> instance, const String& error)
+    {
+        if (instance != nullptr || ! fallback.has_value())
+            callback (std::move (instance), error);
+        else
+            create (*fallback, callback);
+    });
+}
+
+AudioProcessorGraph::Node::Ptr FilterGraphLoader::addNode (AudioProcessorGraph& graph,
+                                                           const XmlElement& xml,
+                                                           std::unique_ptr<AudioPluginInstance> instance,
+                                                           const MemoryBlock& state,
+                                                           String& errorMessage) const
+{
+    if (auto* layoutEntity = xml.getChildByName ("LAYOUT"))
+    {
+        auto layout = instance->getBusesLayout();
+
+        readBusLayoutFromXml (layout, *instance, *layoutEntity, true);
+        readBusLayoutFromXml (layout, *instance, *layoutEntity, false);
+
+        instance->setBusesLayout (layout);
+    }
+
+    auto node = graph.addNode (std::move (instance), AudioProcessorGraph::NodeID ((uint32) xml.getIntAttribute ("uid")));
+
+    if (node == nullptr)
+    {
+        errorMessage = "Duplicate node ID " + xml.getStringAttribute ("uid");
+        return nullptr;
+    }
+
+    if (xml.getChildByName ("STATE") != nullptr)
+        node->getProcessor()->setStateInformation (state.getData(), (int) state.getSize());
+
+    node->properties.set ("x", xml.getDoubleAttribute ("x"));
+    node->properties.set ("y", xml.getDoubleAttribute ("y"));
+    node->properties.set ("useARA", xml.getBoolAttribute ("useARA"));
+
+    return node;
+}
+
+AudioProcessorGraph::Node::Ptr FilterGraphLoader::createNode (AudioProcessorGraph& graph,
+                                                              const XmlElement& xml,
+                                                              String& errorMessage,
+                                                              const FilterGraphStateBlobs* blobs) const
+{
+    auto instance = createInstance (getDescription (xml), graph.getSampleRate(), graph.getBlockSize(), errorMessage);
+
+    if (instance == nullptr)
+        return nullptr;
+
+    return addNode (graph, xml, std::move (instance), getState (xml, blobs), errorMessage);
+}
+
+void FilterGraphLoader::restoreConnections (AudioProcessorGraph& graph, const XmlElement& xml)
+{
+    using NodeID = AudioProcessorGraph::NodeID;
+
+    for (auto* e : xml.getChildWithTagNameIterator ("CONNECTION"))
+    {
+        graph.addConnection ({ { NodeID ((uint32) e->getIntAttribute ("srcFilter")), e->getIntAttribute ("srcChannel") },
+                               { NodeID ((uint32) e->getIntAttribute ("dstFilter")), e->getIntAttribute ("dstChannel") } });
+    }
+
+    graph.removeIllegalConnections();
+}
+
+String FilterGraphLoader::describeFailure (const XmlElement& filter, const String& error)
+{
+    const auto* description = filter.getChildByName ("PLUGIN");
+
+    return (description != nullptr ? description->getStringAttribute ("name") : String ("?"))
+             + ": " + (error.isNotEmpty() ? error : String ("could not be created"));
+}
+
+Result FilterGraphLoader::restoreGraph (AudioProcessorGraph& graph, const XmlElement& xml,
+                                        const FilterGraphStateBlobs* blobs) const
+{
+    if (! xml.hasTagName ("FILTERGRAPH"))
+        return Result::fail ("Not a valid graph file");
+
+    graph.clear();
+
+    StringArray failures;
+
+    for (auto* e : xml.getChildWithTagNameIterator ("FILTER"))
+    {
+        String error;
+
+        if (createNode (graph, *e, error, blobs) == nullptr)
+            failures.add (describeFailure (*e, error));
+    }
+
+    restoreConnections (graph, xml);
+
+    return failures.isEmpty() ? Result::ok() : Result::fail (failures.joinIntoString ("\n"));
+}
+
+//==============================================================================
+AsyncFilterGraphLoad::AsyncFilterGraphLoad (const FilterGraphLoader& l,
+                                            AudioProcessorGraph& g,
+                                            FilterGraphFile::Document toLoad,
+                                            std::function<void (Result)> onComplete)
+    : loader (l),
+      graph (g),
+      document (std::move (toLoad.xml)),
+      blobs (std::move (toLoad.blobs)),
+      completionCallback (std::move (onComplete)),
+      sampleRate (g.getSampleRate()),
+      blockSize (g.getBlockSize()),
+      maxInFlight (jlimit (1, 8, SystemStats::getNumCpus()))
+{
+    jassert (document != nullptr);
+
+    for (auto* e : document->getChildWithTagNameIterator ("FILTER"))
+    {
+        auto& pending = nodes.emplace_back();
+        pending.xml = e;
+        pending.description = FilterGraphLoader::getDescription (*e);
+    }
+
+    if (nodes.empty())
+        triggerAsyncUpdate();
+    else
+        startCreating();
+}
+
+AsyncFilterGraphLoad::~AsyncFilterGraphLoad()
+{
+    cancelled = true;
+    cancelPendingUpdate();
+
+    // creations still in progress find the reference cleared and drop their plug-in
+    masterReference.clear();
+}
+
+void AsyncFilterGraphLoad::cancel()
+{
+    cancelled = true;
+}
+
+double AsyncFilterGraphLoad::getProgress() const noexcept
+{
+    return finished || nodes.empty() ? 1.0 : (double) numCreated / (double) nodes.size();
+}
+
+void AsyncFilterGraphLoad::startCreating()
+{
+    // the synchronous creation functions only hand the work to the message thread and wait for it,
+    // so every plug-in goes through the asynchronous API, with a few of them under way at once
+    while (nextToCreate < nodes.size() && numInFlight < maxInFlight)
+    {
+        const auto index = nextToCreate++;
+
+        if (cancelled)
+        {
+            nodeCreated();
+            continue;
+        }
+
+        ++numInFlight;
+
+        loader.createInstanceAsync (nodes[index].description, sampleRate, blockSize,
+                                    [ref = WeakReference<AsyncFilterGraphLoad> (this), index]
+                                    (std::unique_ptr<AudioPluginInstance> instance, const String& error)
+        {
+            if (ref == nullptr)
+                return;
+
+            --ref->numInFlight;
+            ref->nodes[index].instance = std::move (instance);
+            ref->nodes[index].error = error;
+            ref->nodeCreated();
+
+            // the next one starts after a trip round the message loop, so the UI stays responsive
+            MessageManager::callAsync ([ref]
+            {
+                if (ref != nullptr)
+                    ref->startCreating();
+            });
+        });
+    }
+}
+
+void AsyncFilterGraphLoad::nodeCreated()
+{
+    ++numCreated;
+    triggerAsyncUpdate();
+}
+
+void AsyncFilterGraphLoad::handleAsyncUpdate()
+{
+    if (finished || numCreated < (int) nodes.size())
+        return;
+
+    finished = true;
+
+    if (cancelled)
+    {
+        releaseDocument();
+        NullCheckedInvocation::invoke (completionCallback, Result::fail ("Loading was cancelled"));
+        return;
+    }
+
+    NullCheckedInvocation::invoke (beforeReplacingGraph);
+    graph.clear();
+
+    for (auto& pending : nodes)
+    {
+        auto node = pending.instance != nullptr
+                        ? loader.addNode (graph, *pending.xml, std::move (pending.instance),
+                                          FilterGraphLoader::getState (*pending.xml, blobs.get()), pending.error)
+                        : nullptr;
+
+        if (node == nullptr)
+            failures.add (FilterGraphLoader::describeFailure (*pending.xml, pending.error));
+        else if (onNodeAdded != nullptr)
+            onNodeAdded (*node, *pending.xml);
+    }
+
+    FilterGraphLoader::restoreConnections (graph, *document);
+    releaseDocument();
+
+    // the graph has been replaced, so this counts as loaded even if some plug-ins are missing
+    NullCheckedInvocation::invoke (completionCallback, Result::ok());
+}
+
+void AsyncFilterGraphLoad::releaseDocument()
+{
+    // nothing refers to these any more, and the blobs can be as big as the file itself
+    nodes.clear();
+    document = nullptr;
+    blobs = nullptr;
+}
@@ -0,0 +1,212 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE framework.
+   Copyright (c) Raw Material Software Limited
+
+   JUCE is an open source framework subject to commercial or open source
+   licensing.
+
+   By downloading, installing, or using the JUCE framework, or combining the
+   JUCE framework with any other source code, object code, content or any other
+   copyrightable work, you agree to the terms of the JUCE End User Licence
+   Agreement, and all incorporated terms including the JUCE Privacy Policy and
+   the JUCE Website Terms of Service, as applicable, which will bind you. If you
+   do not agree to the terms of these agreements, we will not license the JUCE
+   framework to you, and you must discontinue the installation or download
+   process and cease use of the JUCE framework.
+
+   JUCE End User Licence Agreement: https://juce.com/legal/juce-8-licence/
+   JUCE Privacy Policy: https://juce.com/juce-privacy-policy
+   JUCE Website Terms of Service: https://juce.com/juce-website-terms-of-service/
+
+   Or:
+
+   You may also use this code under the terms of the AGPLv3:
+   https://www.gnu.org/licenses/agpl-3.0.en.html
+
+   THE JUCE FRAMEWORK IS PROVIDED "AS IS" WITHOUT ANY WARRANTY, AND ALL
+   WARRANTIES, WHETHER EXPRESSED OR IMPLIED, INCLUDING WARRANTY OF
+   MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE, ARE DISCLAIMED.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "FilterGraphFile.h"
+
+//==============================================================================
+/** A type that encapsulates a PluginDescription and some preferences regarding
+    how plugins of that description should be instantiated.
+*/
+struct PluginDescriptionAndPreference
+{
+    enum class UseARA { no, yes };
+
+    PluginDescriptionAndPreference() = default;
+
+    explicit PluginDescriptionAndPreference (PluginDescription pd)
+        : pluginDescription (std::move (pd)),
+          useARA (pluginDescription.hasARAExtension ? PluginDescriptionAndPreference::UseARA::yes
+                                                    : PluginDescriptionAndPreference::UseARA::no)
+    {}
+
+    PluginDescriptionAndPreference (PluginDescription pd, UseARA ara)
+        : pluginDescription (std::move (pd)), useARA (ara)
+    {}
+
+    PluginDescription pluginDescription;
+    UseARA useARA = UseARA::no;
+};
+
+//==============================================================================
+/**
+    Creates the nodes and connections of a .filtergraph document.
+
+    It only needs an AudioProcessorGraph, so the host and the headless renderer
+    read graphs the same way; anything to do with windows is left to the caller.
+*/
+class FilterGraphLoader final : private ChangeListener
+{
+public:
+    using InstanceCallback = std::function<void (std::unique_ptr<AudioPluginInstance>, const String& error)>;
+
+    FilterGraphLoader (AudioPluginFormatManager&, KnownPluginList&);
+    ~FilterGraphLoader() override;
+
+    static PluginDescriptionAndPreference getDescription (const XmlElement& filter);
+
+    /** Decodes a FILTER element's state, either from its base64 text or, in a binary
+        document, from the blob it refers to.
+    */
+    static MemoryBlock getState (const XmlElement& filter, const FilterGraphStateBlobs* blobs = nullptr);
+
+    /** Creates a plug-in, falling back to a known plug-in with the same unique ID
+        if the description's file has moved.
+    */
+    std::unique_ptr<AudioPluginInstance> createInstance (const PluginDescriptionAndPreference&,
+                                                         double sampleRate, int blockSize,
+                                                         String& errorMessage) const;
+
+    /** The same, for formats that need the message thread to be running while they create a plug-in. */
+    void createInstanceAsync (const PluginDescriptionAndPreference&, double sampleRate, int blockSize,
+                              InstanceCallback) const;
+
+    /** Adds a node for a plug-in created from a FILTER element, with the element's bus layout, state and position. */
+    AudioProcessorGraph::Node::Ptr addNode (AudioProcessorGraph&, const XmlElement& filter,
+                                            std::unique_ptr<AudioPluginInstance>, const MemoryBlock& state,
+                                            String& errorMessage) const;
+
+    /** Creates and adds the node a FILTER element describes. */
+    AudioProcessorGraph::Node::Ptr createNode (AudioProcessorGraph&, const XmlElement& filter, String& errorMessage,
+                                               const FilterGraphStateBlobs* blobs = nullptr) const;
+
+    static void restoreConnections (AudioProcessorGraph&, const XmlElement& filterGraph);
+    static String describeFailure (const XmlElement& filter, const String& error);
+
+    /** Replaces the graph's contents. Nodes that can't be created are skipped and listed in the result. */
+    Result restoreGraph (AudioProcessorGraph&, const XmlElement& filterGraph,
+                         const FilterGraphStateBlobs* blobs = nullptr) const;
+
+    // e.g. to turn off DPI awareness while creating a plug-in that can't scale its editor
+    std::function<std::unique_ptr<ScopedDPIAwarenessDisabler> (const PluginDescription&)> makeDPIAwarenessDisabler;
+
+private:
+    AudioPluginFormat* findFormat (const PluginDescription&) const;
+    std::optional<PluginDescriptionAndPreference> findKnownFallback (const PluginDescriptionAndPreference&) const;
+
+    void changeListenerCallback (ChangeBroadcaster*) override;
+
+    AudioPluginFormatManager& formatManager;
+    KnownPluginList& knownPlugins;
+
+    // "format:uniqueId" -> the first known plug-in with it, built on first use and
+    // dropped whenever the list changes; guarded by the lock, as loads use it from any thread
+    mutable CriticalSection fallbackLock;
+    mutable std::optional<std::unordered_map<String, PluginDescription>> fallbackIndex;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (FilterGraphLoader)
+};
+
+//==============================================================================
+/**
+    Loads a .filtergraph document without blocking the message thread.
+
+    The plug-ins are created through the formats' asynchronous API, several
+    at a time, so formats that can create them in the background do so while
+    the others take turns with the message thread's event loop. Once every
+    plug-in exists, the graph is cleared and the nodes, their state and the
+    connections are put in place in one go on the message thread.
+
+    Cancelling stops any plug-in that hasn't been started yet from being
+    created, and leaves the graph untouched.
+*/
+class AsyncFilterGraphLoad final : private AsyncUpdater
+{
+public:
+    /** Starts loading straight away; the callback is called on the message thread.
+
+        The result only fails if the load was cancelled: once the graph has been
+        replaced it's ok, even if some plug-ins couldn't be created - those are
+        listed by getFailures().
+    */
+    AsyncFilterGraphLoad (const FilterGraphLoader&, AudioProcessorGraph&,
+                          FilterGraphFile::Document,
+                          std::function<void (Result)> onComplete);
+
+    /** Doesn't wait: plug-ins still being created are deleted as soon as they arrive. */
+    ~AsyncFilterGraphLoad() override;
+
+    void cancel();
+    bool isCancelled() const noexcept           { return cancelled; }
+    bool isFinished() const noexcept            { return finished; }
+
+    /** The fraction of plug-ins created so far. */
+    double getProgress() const noexcept;
+
+    /** Once finished, a line for each plug-in that couldn't be put back in the graph. */
+    const StringArray& getFailures() const noexcept     { return failures; }
+
+    // called just before the graph is cleared to make way for the loaded nodes
+    std::function<void()> beforeReplacingGraph;
+
+    // called for each node as it's added to the graph, e.g. to reopen its windows
+    std::function<void (AudioProcessorGraph::Node&, const XmlElement& filter)> onNodeAdded;
+
+private:
+    struct PendingNode
+    {
+        const XmlElement* xml = nullptr;
+        PluginDescriptionAndPreference description;
+        std::unique_ptr<AudioPluginInstance> instance;
+        String error;
+    };
+
+    void startCreating();
+    void nodeCreated();
+    void handleAsyncUpdate() override;
+    void releaseDocument();
+
+    const FilterGraphLoader& loader;
+    AudioProcessorGraph& graph;
+    std::unique_ptr<XmlElement> document;
+    std::shared_ptr<const FilterGraphStateBlobs> blobs;
+    std::function<void (Result)> completionCallback;
+    const double sampleRate;
+    const int blockSize;
+
+    std::vector<PendingNode> nodes;
+    size_t nextToCreate = 0;
+    int numInFlight = 0;
+    const int maxInFlight;
+
+    int numCreated = 0;
+    bool cancelled = false;
+    bool finished = false;
+    StringArray failures;
+
+    JUCE_DECLARE_WEAK_REFERENCEABLE (AsyncFilterGraphLoad)
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (AsyncFilterGraphLoad)
+};
@@ -0,0 +1,154 @@
+#include <JuceHeader.h>
+#include "NodeProfiler.h"
+
+//==============================================================================
+NodeProfiler::~NodeProfiler()
+{
+    stopTimer();
+}
+
+void NodeProfiler::setEnabled (bool shouldProfile)
+{
+    if (enabled == shouldProfile)
+        return;
+
+    enabled = shouldProfile;
+
+    if (enabled)
+    {
+        reset();
+        startTimerHz (4);
+    }
+    else
+    {
+        stopTimer();
+    }
+
+    sendChangeMessage();
+}
+
+void NodeProfiler::setBufferPeriod (int samplesPerBlock, double sampleRate) noexcept
+{
+    bufferPeriodSeconds = sampleRate > 0.0 ? samplesPerBlock / sampleRate : 0.0;
+}
+
+std::shared_ptr<NodeProfiler::Recorder> NodeProfiler::getRecorder (AudioProcessorGraph::NodeID nodeID)
+{
+    auto& history = histories[nodeID];
+
+    if (history.recorder == nullptr)
+        history.recorder = std::make_shared<Recorder>();
+
+    return history.recorder;
+}
+
+void NodeProfiler::forgetAllExcept (const std::set<AudioProcessorGraph::NodeID>& liveNodes)
+{
+    for (auto it = histories.begin(); it != histories.end();)
+    {
+        if (liveNodes.count (it->first) == 0)
+            it = histories.erase (it);
+        else
+            ++it;
+    }
+}
+
+std::optional<NodeProfiler::Stats> NodeProfiler::getStats (AudioProcessorGraph::NodeID nodeID) const
+{
+    const auto found = histories.find (nodeID);
+    return found != histories.end() ? found->second.stats : std::nullopt;
+}
+
+void NodeProfiler::reset()
+{
+    for (auto& [nodeID, history] : histories)
+    {
+        history.read = history.recorder->written.load (std::memory_order_acquire);
+        history.durations.clear();
+        history.next = 0;
+        history.stats.reset();
+    }
+}
+
+//==============================================================================
+void NodeProfiler::timerCallback()
+{
+    for (auto& [nodeID, history] : histories)
+        collect (history);
+
+    sendChangeMessage();
+}
+
+void NodeProfiler::collect (History& history) const
+{
+    const auto& recorder = *history.recorder;
+    const auto written = recorder.written.load (std::memory_order_acquire);
+
+    // if the audio thread has lapped us, only the latest ring's worth is still there
+    if (written - history.read > Recorder::capacity)
+        history.read = written - Recorder::capacity;
+
+    for (; history.read != written; ++history.read)
+    {
+        const auto duration = recorder.durations[history.read % Recorder::capacity].load (std::memory_order_relaxed);
+
+        if (history.durations.size() < windowSize)
+        {
+            history.durations.push_back (duration);
+        }
+        else
+        {
+            history.durations[history.next] = duration;
+            history.next = (history.next + 1) % windowSize;
+        }
+    }
+
+    if (history.durations.empty())
+        return;
+
+    auto sorted = history.durations;
+    std::sort (sorted.begin(), sorted.end());
+
+    const auto total = std::accumulate (sorted.begin(), sorted.end(), 0.0);
+    const auto period = bufferPeriodSeconds.load();
+
+    Stats stats;
+    stats.numBlocks     = (int) sorted.size();
+    stats.minMicros     = sorted.front() * 1.0e-3;
+    stats.maxMicros     = sorted.back() * 1.0e-3;
+    stats.averageMicros = total / (double) sorted.size() * 1.0e-3;
+    stats.p99Micros     = sorted[(sorted.size() - 1) * 99 / 100] * 1.0e-3;
+
+    if (period > 0.0)
+        stats.percentOfBuffer = stats.averageMicros * 1.0e-4 / period;
+
+    history.stats = stats;
+}
+
+//==============================================================================
+String NodeProfiler::toCSV (const AudioProcessorGraph& graph) const
+{
+    String csv ("node_id,name,min_us,avg_us,max_us,p99_us,percent_of_buffer,latency_samples,blocks\n");
+
+    for (auto& [nodeID, history] : histories)
+    {
+        auto* node = graph.getNodeForId (nodeID);
+
+        if (node == nullptr || ! history.stats.has_value())
+            continue;
+
+        const auto& stats = *history.stats;
+
+        csv << String (nodeID.uid) << ','
+            << node->getProcessor()->getName().replace (",", " ") << ','
+            << String (stats.minMicros, 2) << ','
+            << String (stats.averageMicros, 2) << ','
+            << String (stats.maxMicros, 2) << ','
+            << String (stats.p99Micros, 2) << ','
+            << String (stats.percentOfBuffer, 2) << ','
+            << node->getProcessor()->getLatencySamples() << ','
+            << stats.numBlocks << '\n';
+    }
+
+    return csv;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/**
+    Collects how long each node of a graph takes to process a block.
+
+    The renderer asks for a Recorder per node and writes one duration into it
+    after every processBlock call. A Recorder is a ring of atomics with a single
+    writer, so recording never waits. The profiler drains the rings on the
+    message thread a few times a second and keeps the last few thousand blocks
+    of every node to compute its statistics from.
+*/
+class NodeProfiler final : public ChangeBroadcaster,
+                           private Timer
+{
+public:
+    class Recorder
+    {
+    public:
+        void record (int64 startTicks, int64 endTicks) noexcept
+        {
+            const auto nanos = (double) (endTicks - startTicks) * 1.0e9 / (double) Time::getHighResolutionTicksPerSecond();
+            const auto index = written.load (std::memory_order_relaxed);
+
+            durations[index % capacity].store ((uint32) jmin (nanos, (double) std::numeric_limits<uint32>::max()),
+                                               std::memory_order_relaxed);
+            written.store (index + 1, std::memory_order_release);
+        }
+
+    private:
+        friend class NodeProfiler;
+
+        static constexpr uint32 capacity = 1024;
+
+        std::array<std::atomic<uint32>, capacity> durations {};
+        std::atomic<uint32> written { 0 };
+    };
+
+    struct Stats
+    {
+        double minMicros = 0, averageMicros = 0, maxMicros = 0, p99Micros = 0;
+        double percentOfBuffer = 0;     // the average against the time one buffer lasts
+        int numBlocks = 0;
+    };
+
+    NodeProfiler() = default;
+    ~NodeProfiler() override;
+
+    void setEnabled (bool shouldProfile);
+    bool isEnabled() const noexcept                     { return enabled; }
+
+    // may be called from the audio thread, when the device is (re)started
+    void setBufferPeriod (int samplesPerBlock, double sampleRate) noexcept;
+
+    // message thread only
+    std::shared_ptr<Recorder> getRecorder (AudioProcessorGraph::NodeID);
+    void forgetAllExcept (const std::set<AudioProcessorGraph::NodeID>& liveNodes);
+    std::optional<Stats> getStats (AudioProcessorGraph::NodeID) const;
+    void reset();
+
+    // one row per node that has been timed
+    String toCSV (const AudioProcessorGraph&) const;
+
+private:
+    struct History
+    {
+        std::shared_ptr<Recorder> recorder;
+        uint32 read = 0;
+        std::vector<uint32> durations;  // the latest window of nanoseconds, oldest first once full
+        size_t next = 0;
+        std::optional<Stats> stats;
+    };
+
+    static constexpr size_t windowSize = 4096;
+
+    void timerCallback() override;
+    void collect (History&) const;
+
+    std::map<AudioProcessorGraph::NodeID, History> histories;
+    std::atomic<double> bufferPeriodSeconds { 0.0 };
+    bool enabled = false;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (NodeProfiler)
+};
@@ -0,0 +1,567 @@
+#include <JuceHeader.h>
+#include "ParallelGraphRenderer.h"
+
+#if JUCE_INTEL
+ #include <immintrin.h>
+#endif
+
+//==============================================================================
+namespace
+{
+    // how long a thread keeps checking before it yields (the audio thread) or sleeps (a worker)
+    constexpr int maxSpins = 1000;
+
+    // tells the core this is a spin-wait, so it backs off instead of hammering the cache line
+    inline void spinPause() noexcept
+    {
+       #if JUCE_INTEL
+        _mm_pause();
+       #elif JUCE_ARM && (JUCE_GCC || JUCE_CLANG)
+        __asm__ __volatile__ ("yield");
+       #endif
+    }
+}
+
+//==============================================================================
+struct ParallelGraphRenderer::Plan
+{
+    struct AudioInput
+    {
+        int source, sourceChannel, destChannel;
+    };
+
+    struct NodeState
+    {
+        AudioProcessorGraph::Node::Ptr node;
+        AudioProcessor* processor = nullptr;
+        int ioType = -1;                    // an AudioGraphIOProcessor::IODeviceType, or -1 for a plug-in
+        AudioBuffer<float> buffer;
+        MidiBuffer midi;
+        std::vector<AudioInput> audioInputs;
+        std::vector<int> midiInputs;
+        std::shared_ptr<NodeProfiler::Recorder> recorder;  // only while profiling
+    };
+
+    std::vector<NodeState> nodes;
+    std::vector<std::vector<int>> levels;
+    std::vector<int> outputs;
+    int blockSize = 0;
+    bool parallel = false;              // otherwise it is only here to time the nodes
+
+    // the block being rendered, set by the audio thread before the first level
+    const AudioBuffer<float>* hostInput = nullptr;
+    const MidiBuffer* hostMidi = nullptr;
+};
+
+//==============================================================================
+class ParallelGraphRenderer::Worker final : public Thread
+{
+public:
+    Worker (ParallelGraphRenderer& o, size_t queue)
+        : Thread ("Graph render worker " + String ((int) queue)),
+          owner (o),
+          queueIndex (queue)
+    {
+    }
+
+    // called by the audio thread for each level that has work to share
+    void wake()
+    {
+        if (sleeping.exchange (false, std::memory_order_acq_rel))
+            notify();
+    }
+
+    void run() override
+    {
+        if (owner.options.affinityMask != 0)
+            setCurrentThreadAffinityMask (owner.options.affinityMask);
+
+        uint32 lastGeneration = 0;
+
+        while (! threadShouldExit())
+        {
+            sleeping.store (true, std::memory_order_release);
+
+            // a level published after the flag was set either shows up here or signals the event
+            if (owner.publishedGeneration.load (std::memory_order_acquire) == lastGeneration)
+                wait (-1);
+
+            sleeping.store (false, std::memory_order_release);
+
+            // the next parallel level of a block usually follows soon, so keep watching for a while
+            for (int spins = 0; spins < maxSpins && ! threadShouldExit(); ++spins)
+            {
+                const auto generation = owner.publishedGeneration.load (std::memory_order_acquire);
+
+                if (generation != lastGeneration)
+                {
+                    owner.drain (queueIndex, generation);
+                    lastGeneration = generation;
+                    spins = 0;
+                }
+                else
+                {
+                    spinPause();
+                }
+            }
+        }
+    }
+
+private:
+    ParallelGraphRenderer& owner;
+    const size_t queueIndex;
+    std::atomic<bool> sleeping { false };
+};
+
+//==============================================================================
+void ParallelGraphRenderer::PlanExchange::set (std::unique_ptr<Plan>&& next)
+{
+    const SpinLock::ScopedLockType lock (mutex);
+    mainThreadState = std::move (next);
+    isNew = true;
+}
+
+void ParallelGraphRenderer::PlanExchange::updateAudioThreadState()
+{
+    const SpinLock::ScopedTryLockType lock (mutex);
+
+    if (lock.isLocked() && isNew)
+    {
+        // the old plan goes back to the message thread, which deletes it in releaseOld()
+        std::swap (mainThreadState, audioThreadState);
+        isNew = false;
+    }
+}
+
+bool ParallelGraphRenderer::PlanExchange::releaseOld()
+{
+    const SpinLock::ScopedLockType lock (mutex);
+
+    if (isNew)
+        return false;
+
+    mainThreadState.reset();
+    return true;
+}
+
+//==============================================================================
+ParallelGraphRenderer::ParallelGraphRenderer (AudioProcessorGraph& g, Options o)
+    : graph (g),
+      options (o),
+      queues ((size_t) jmax (0, o.numWorkers) + 1)
+{
+    for (size_t i = 1; i < queues.size(); ++i)
+    {
+        auto* worker = workers.add (new Worker (*this, i));
+
+        if (! worker->startRealtimeThread (Thread::RealtimeOptions{}))
+            worker->startThread (Thread::Priority::highest);
+    }
+
+    graph.addChangeListener (this);
+    triggerAsyncUpdate();
+}
+
+ParallelGraphRenderer::~ParallelGraphRenderer()
+{
+    graph.removeChangeListener (this);
+    cancelPendingUpdate();
+    stopTimer();
+
+    for (auto* worker : workers)
+    {
+        worker->signalThreadShouldExit();
+        worker->notify();
+    }
+
+    for (auto* worker : workers)
+        worker->stopThread (1000);
+}
+
+void ParallelGraphRenderer::setParallelRenderingEnabled (bool shouldRenderInParallel)
+{
+    parallelEnabled = shouldRenderInParallel;
+    triggerAsyncUpdate();
+}
+
+void ParallelGraphRenderer::setProfilingEnabled (bool shouldProfile)
+{
+    profiler.setEnabled (shouldProfile);
+    triggerAsyncUpdate();
+}
+
+//==============================================================================
+void ParallelGraphRenderer::prepareToPlay (double sampleRate, int samplesPerBlock)
+{
+    graph.setProcessingPrecision (getProcessingPrecision());
+    graph.setPlayConfigDetails (getTotalNumInputChannels(), getTotalNumOutputChannels(), sampleRate, samplesPerBlock);
+    graph.setNonRealtime (isNonRealtime());
+    graph.prepareToPlay (sampleRate, samplesPerBlock);
+
+    setLatencySamples (graph.getLatencySamples());
+    profiler.setBufferPeriod (samplesPerBlock, sampleRate);
+
+    // the plan's buffers are sized for this block size, so the old one must go
+    plans.set (nullptr);
+    triggerAsyncUpdate();
+}
+
+void ParallelGraphRenderer::releaseResources()
+{
+    plans.set (nullptr);
+    graph.releaseResources();
+}
+
+void ParallelGraphRenderer::reset()
+{
+    graph.reset();
+}
+
+//==============================================================================
+void ParallelGraphRenderer::processBlock (AudioBuffer<double>& buffer, MidiBuffer& midiMessages)
+{
+    graph.setPlayHead (getPlayHead());
+    graph.processBlock (buffer, midiMessages);
+}
+
+void ParallelGraphRenderer::processBlock (AudioBuffer<float>& buffer, MidiBuffer& midiMessages)
+{
+    plans.updateAudioThreadState();
+    auto* plan = plans.getAudioThreadState();
+    const auto numSamples = buffer.getNumSamples();
+
+    if (plan == nullptr || numSamples > plan->blockSize)
+    {
+        graph.setPlayHead (getPlayHead());
+        graph.processBlock (buffer, midiMessages);
+        return;
+    }
+
+    plan->hostInput = &buffer;
+    plan->hostMidi = &midiMessages;
+
+    for (auto& level : plan->levels)
+        renderLevel (*plan, level, numSamples);
+
+    buffer.clear();
+    midiMessages.clear();
+
+    for (auto index : plan->outputs)
+    {
+        auto& output = plan->nodes[(size_t) index];
+
+        if (output.ioType == AudioProcessorGraph::AudioGraphIOProcessor::midiOutputNode)
+        {
+            midiMessages.addEvents (output.midi, 0, numSamples, 0);
+            continue;
+        }
+
+        for (int ch = 0; ch < jmin (buffer.getNumChannels(), output.buffer.getNumChannels()); ++ch)
+            buffer.addFrom (ch, 0, output.buffer, ch, 0, numSamples);
+    }
+}
+
+//==============================================================================
+void ParallelGraphRenderer::renderLevel (Plan& plan, const std::vector<int>& level, int numSamples)
+{
+    if (level.size() == 1 || ! plan.parallel)
+    {
+        for (auto index : level)
+            renderNode (plan, index, numSamples);
+
+        return;
+    }
+
+    const auto generation = ++nextGeneration;
+    const auto numItems = (int) level.size();
+    const auto numQueues = (int) queues.size();
+
+    currentPlan = &plan;
+    currentNumSamples = numSamples;
+    remaining.store (numItems, std::memory_order_relaxed);
+
+    // each thread starts on its own contiguous slice, and the cursor is written last so that
+    // anyone who sees the new generation also sees the slice it belongs to
+    for (int q = 0; q < numQueues; ++q)
+    {
+        auto& queue = queues[(size_t) q];
+        const auto begin = numItems * q / numQueues;
+
+        queue.items.store (level.data(), std::memory_order_relaxed);
+        queue.end.store (numItems * (q + 1) / numQueues, std::memory_order_relaxed);
+        queue.cursor.store (((uint64) generation << 32) | (uint32) begin, std::memory_order_release);
+    }
+
+    publishedGeneration.store (generation, std::memory_order_release);
+
+    // the audio thread takes a share itself, so one node fewer than there are needs a worker
+    for (int i = 0; i < jmin (workers.size(), numItems - 1); ++i)
+        workers.getUnchecked (i)->wake();
+
+    drain (0, generation);
+
+    // whatever is left is being rendered by a worker right now
+    for (int spins = 0; remaining.load (std::memory_order_acquire) > 0; ++spins)
+    {
+        if (spins < maxSpins)
+            spinPause();
+        else
+            Thread::yield();
+    }
+}
+
+void ParallelGraphRenderer::drain (size_t queueIndex, uint32 generation)
+{
+    const auto numQueues = queues.size();
+
+    for (size_t i = 0; i < numQueues; ++i)
+    {
+        auto& queue = queues[(queueIndex + i) % numQueues];
+        int item = 0;
+
+        while (claim (queue, generation, item))
+        {
+            renderNode (*currentPlan, item, currentNumSamples);
+            remaining.fetch_sub (1, std::memory_order_acq_rel);
+        }
+    }
+}
+
+bool ParallelGraphRenderer::claim (WorkQueue& queue, uint32 generation, int& item)
+{
+    auto cursor = queue.cursor.load (std::memory_order_acquire);
+
+    for (;;)
+    {
+        const auto index = (int) (uint32) cursor;
+
+        if ((uint32) (cursor >> 32) != generation || index >= queue.end.load (std::memory_order_relaxed))
+            return false;
+
+        if (queue.cursor.compare_exchange_weak (cursor, cursor + 1, std::memory_order_acq_rel))
+        {
+            item = queue.items.load (std::memory_order_relaxed)[index];
+            return true;
+        }
+    }
+}
+
+void ParallelGraphRenderer::renderNode (Plan& plan, int index, int numSamples)
+{
+    using IOProcessor = AudioProcessorGraph::AudioGraphIOProcessor;
+
+    auto& state = plan.nodes[(size_t) index];
+    auto& buffer = state.buffer;
+
+    buffer.setSize (buffer.getNumChannels(), numSamples, false, false, true);
+    buffer.clear();
+    state.midi.clear();
+
+    for (auto& input : state.audioInputs)
+        buffer.addFrom (input.destChannel, 0, plan.nodes[(size_t) input.source].buffer, input.sourceChannel, 0, numSamples);
+
+    for (auto source : state.midiInputs)
+        state.midi.addEvents (plan.nodes[(size_t) source].midi, 0, numSamples, 0);
+
+    switch (state.ioType)
+    {
+        case IOProcessor::audioInputNode:
+            for (int ch = 0; ch < jmin (buffer.getNumChannels(), plan.hostInput->getNumChannels()); ++ch)
+                buffer.copyFrom (ch, 0, *plan.hostInput, ch, 0, numSamples);
+            return;
+
+        case IOProcessor::midiInputNode:
+            state.midi.addEvents (*plan.hostMidi, 0, numSamples, 0);
+            return;
+
+        case IOProcessor::audioOutputNode:
+        case IOProcessor::midiOutputNode:
+            return;
+
+        default:
+            break;
+    }
+
+    auto* processor = state.processor;
+    processor->setPlayHead (getPlayHead());
+
+    const ScopedLock sl (processor->getCallbackLock());
+    const auto startTicks = state.recorder != nullptr ? Time::getHighResolutionTicks() : 0;
+
+    if (processor->isSuspended())
+        buffer.clear();
+    else if (state.node->isBypassed())
+        processor->processBlockBypassed (buffer, state.midi);
+    else
+        processor->processBlock (buffer, state.midi);
+
+    if (state.recorder != nullptr)
+        state.recorder->record (startTicks, Time::getHighResolutionTicks());
+}
+
+//==============================================================================
+std::unique_ptr<ParallelGraphRenderer::Plan> ParallelGraphRenderer::buildPlan()
+{
+    using IOProcessor = AudioProcessorGraph::AudioGraphIOProcessor;
+
+    const auto profiling = profiler.isEnabled();
+
+    if (! (profiling || (parallelEnabled && ! workers.isEmpty()))
+         || getBlockSize() <= 0 || getProcessingPrecision() == doublePrecision)
+        return nullptr;
+
+    auto plan = std::make_unique<Plan>();
+    plan->blockSize = getBlockSize();
+
+    std::map<AudioProcessorGraph::NodeID, int> indices;
+    int numPlugins = 0;
+
+    for (auto* node : graph.getNodes())
+    {
+        auto* processor = node->getProcessor();
+
+        // delay compensation is left to the graph
+        if (processor->getLatencySamples() > 0)
+            return nullptr;
+
+        Plan::NodeState state;
+        state.node = node;
+        state.processor = processor;
+
+        if (auto* io = dynamic_cast<IOProcessor*> (processor))
+        {
+            state.ioType = io->getType();
+        }
+        else
+        {
+            ++numPlugins;
+
+            if (profiling)
+                state.recorder = profiler.getRecorder (node->nodeID);
+        }
+
+        const auto numChannels = jmax (processor->getTotalNumInputChannels(), processor->getTotalNumOutputChannels());
+        state.buffer.setSize (numChannels, plan->blockSize);
+        state.midi.ensureSize (2048);
+
+        indices[node->nodeID] = (int) plan->nodes.size();
+        plan->nodes.push_back (std::move (state));
+    }
+
+    const auto numNodes = plan->nodes.size();
+    std::vector<std::set<int>> successors (numNodes);
+    std::vector<int> numPredecessors (numNodes, 0);
+
+    for (auto& connection : graph.getConnections())
+    {
+        const auto source = indices.find (connection.source.nodeID);
+        const auto dest   = indices.find (connection.destination.nodeID);
+
+        if (source == indices.end() || dest == indices.end())
+            continue;
+
+        auto& destState = plan->nodes[(size_t) dest->second];
+
+        if (connection.destination.isMIDI())
+        {
+            destState.midiInputs.push_back (source->second);
+        }
+        else
+        {
+            if (connection.destination.channelIndex >= destState.buffer.getNumChannels()
+                 || connection.source.channelIndex >= plan->nodes[(size_t) source->second].buffer.getNumChannels())
+                continue;
+
+            destState.audioInputs.push_back ({ source->second, connection.source.channelIndex,
+                                               connection.destination.channelIndex });
+        }
+
+        if (successors[(size_t) source->second].insert (dest->second).second)
+            ++numPredecessors[(size_t) dest->second];
+    }
+
+    // Kahn's algorithm, keeping each node at the level after its deepest input
+    std::vector<int> depth (numNodes, 0), ready;
+
+    for (size_t i = 0; i < numNodes; ++i)
+        if (numPredecessors[i] == 0)
+            ready.push_back ((int) i);
+
+    size_t numSorted = 0;
+
+    while (! ready.empty())
+    {
+        const auto index = ready.back();
+        ready.pop_back();
+        ++numSorted;
+
+        if ((size_t) depth[(size_t) index] >= plan->levels.size())
+            plan->levels.resize ((size_t) depth[(size_t) index] + 1);
+
+        plan->levels[(size_t) depth[(size_t) index]].push_back (index);
+
+        for (auto next : successors[(size_t) index])
+        {
+            depth[(size_t) next] = jmax (depth[(size_t) next], depth[(size_t) index] + 1);
+
+            if (--numPredecessors[(size_t) next] == 0)
+                ready.push_back (next);
+        }
+    }
+
+    // a feedback loop can't be split into levels
+    if (numSorted != numNodes)
+        return nullptr;
+
+    size_t widestLevel = 0;
+
+    for (auto& level : plan->levels)
+    {
+        widestLevel = jmax (widestLevel, (size_t) std::count_if (level.begin(), level.end(), [&] (int i)
+        {
+            return plan->nodes[(size_t) i].ioType < 0;
+        }));
+    }
+
+    plan->parallel = parallelEnabled && ! workers.isEmpty()
+                      && numPlugins >= options.minNodesForParallel && widestLevel >= 2;
+
+    if (! (plan->parallel || profiling))
+        return nullptr;
+
+    for (size_t i = 0; i < numNodes; ++i)
+        if (plan->nodes[i].ioType == IOProcessor::audioOutputNode || plan->nodes[i].ioType == IOProcessor::midiOutputNode)
+            plan->outputs.push_back ((int) i);
+
+    return plan;
+}
+
+//==============================================================================
+void ParallelGraphRenderer::changeListenerCallback (ChangeBroadcaster*)
+{
+    triggerAsyncUpdate();
+}
+
+void ParallelGraphRenderer::handleAsyncUpdate()
+{
+    // make sure every node in the graph has been prepared before a plan refers to it
+    graph.rebuild();
+    setLatencySamples (graph.getLatencySamples());
+
+    std::set<AudioProcessorGraph::NodeID> liveNodes;
+
+    for (auto* node : graph.getNodes())
+        liveNodes.insert (node->nodeID);
+
+    profiler.forgetAllExcept (liveNodes);
+
+    plans.set (buildPlan());
+    startTimer (500);
+}
+
+void ParallelGraphRenderer::timerCallback()
+{
+    // keep trying until the audio thread has picked up the latest plan
+    if (plans.releaseOld())
+        stopTimer();
+}
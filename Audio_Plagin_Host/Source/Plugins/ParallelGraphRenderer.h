@@ -0,0 +1,140 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "NodeProfiler.h"
+
+//==============================================================================
+/**
+    Plays an AudioProcessorGraph with its independent nodes spread over a pool
+    of real-time worker threads.
+
+    The graph is split into dependency levels: a node only takes input from
+    nodes in earlier levels, so all the nodes of one level can run at once.
+    The audio thread hands each level out over one queue per thread; a thread
+    that has emptied its own queue steals from the others, and the audio
+    thread works through the queues too instead of waiting. Workers are only
+    woken for levels with more than one node, spin briefly afterwards in case
+    another one follows, and then go back to sleep.
+
+    Graphs that would not gain from this (too few plug-ins, or no level with
+    two of them), graphs whose latency has to be compensated, and double
+    precision processing are played serially by the AudioProcessorGraph
+    itself. The graph still owns, prepares and releases every node either way.
+
+    While profiling is on, graphs that would otherwise fall back to the
+    AudioProcessorGraph are rendered level by level on the audio thread, so
+    that every plug-in can be timed.
+*/
+class ParallelGraphRenderer final : public AudioProcessor,
+                                    private ChangeListener,
+                                    private AsyncUpdater,
+                                    private Timer
+{
+public:
+    struct Options
+    {
+        int numWorkers = jlimit (0, 7, SystemStats::getNumCpus() - 1);
+        int minNodesForParallel = 4;    // graphs with fewer plug-ins than this are rendered serially
+        uint32 affinityMask = 0;        // the cores the workers may run on, or 0 to leave it to the OS
+    };
+
+    ParallelGraphRenderer (AudioProcessorGraph&, Options);
+    ~ParallelGraphRenderer() override;
+
+    void setParallelRenderingEnabled (bool shouldRenderInParallel);
+
+    void setProfilingEnabled (bool shouldProfile);
+    NodeProfiler& getProfiler() noexcept                    { return profiler; }
+
+    // for hosts without a message loop: builds the plan a change is waiting for right away
+    void rebuildPlanNow()                                   { handleUpdateNowIfNeeded(); }
+
+    //==============================================================================
+    const String getName() const override                   { return graph.getName(); }
+
+    void prepareToPlay (double sampleRate, int samplesPerBlock) override;
+    void releaseResources() override;
+    void reset() override;
+
+    void processBlock (AudioBuffer<float>&, MidiBuffer&) override;
+    void processBlock (AudioBuffer<double>&, MidiBuffer&) override;
+    bool supportsDoublePrecisionProcessing() const override { return true; }
+
+    double getTailLengthSeconds() const override            { return graph.getTailLengthSeconds(); }
+    bool acceptsMidi() const override                       { return true; }
+    bool producesMidi() const override                      { return true; }
+
+    bool hasEditor() const override                         { return false; }
+    AudioProcessorEditor* createEditor() override           { return nullptr; }
+
+    int getNumPrograms() override                           { return 1; }
+    int getCurrentProgram() override                        { return 0; }
+    void setCurrentProgram (int) override                   {}
+    const String getProgramName (int) override              { return {}; }
+    void changeProgramName (int, const String&) override    {}
+
+    void getStateInformation (MemoryBlock&) override        {}
+    void setStateInformation (const void*, int) override    {}
+
+private:
+    //==============================================================================
+    struct Plan;
+    class Worker;
+
+    // a slice of the current level; the cursor carries the level's generation in its top half,
+    // so a thread still looking at an earlier level can never claim from this one
+    struct WorkQueue
+    {
+        std::atomic<uint64> cursor { 0 };
+        std::atomic<int> end { 0 };
+        std::atomic<const int*> items { nullptr };
+    };
+
+    // the message thread builds plans, the audio thread picks them up at the start of a block
+    class PlanExchange
+    {
+    public:
+        void set (std::unique_ptr<Plan>&&);
+        void updateAudioThreadState();
+        Plan* getAudioThreadState() const noexcept      { return audioThreadState.get(); }
+        bool releaseOld();      // false while the audio thread has yet to take the latest plan
+
+    private:
+        SpinLock mutex;
+        std::unique_ptr<Plan> mainThreadState, audioThreadState;
+        bool isNew = false;
+    };
+
+    //==============================================================================
+    std::unique_ptr<Plan> buildPlan();
+
+    void renderLevel (Plan&, const std::vector<int>& level, int numSamples);
+    void renderNode (Plan&, int index, int numSamples);
+    void drain (size_t queueIndex, uint32 generation);
+    bool claim (WorkQueue&, uint32 generation, int& item);
+
+    void changeListenerCallback (ChangeBroadcaster*) override;
+    void handleAsyncUpdate() override;
+    void timerCallback() override;
+
+    //==============================================================================
+    AudioProcessorGraph& graph;
+    const Options options;
+    std::atomic<bool> parallelEnabled { true };
+
+    PlanExchange plans;
+    NodeProfiler profiler;
+
+    std::vector<WorkQueue> queues;      // queue 0 belongs to the audio thread
+    OwnedArray<Worker> workers;
+
+    std::atomic<uint32> publishedGeneration { 0 };
+    std::atomic<int> remaining { 0 };
+    uint32 nextGeneration = 0;
+
+    // only read by a thread that has claimed a node of the current level
+    Plan* currentPlan = nullptr;
+    int currentNumSamples = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ParallelGraphRenderer)
+};
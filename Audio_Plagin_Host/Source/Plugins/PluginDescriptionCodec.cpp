@@ -0,0 +1,93 @@
+#include <JuceHeader.h>
+#include "PluginDescriptionCodec.h"
+
+static constexpr char magic[4] = { 'P', 'D', 'S', 'C' };
+
+// the fixed-size fields that follow the strings of one description
+static constexpr int64 fixedFieldsSize = 2 * 8 + 4 * 4 + 3;
+
+// the least one description can take up, with all its strings empty
+static constexpr int64 minEncodedSize = 7 + fixedFieldsSize;
+
+//==============================================================================
+MemoryBlock PluginDescriptionCodec::encode (const OwnedArray<PluginDescription>& descriptions)
+{
+    MemoryBlock block;
+    MemoryOutputStream out (block, false);
+
+    out.write (magic, sizeof (magic));
+    out.writeInt (version);
+    out.writeInt (descriptions.size());
+
+    for (const auto* d : descriptions)
+    {
+        for (const auto* s : { &d->name, &d->descriptiveName, &d->pluginFormatName, &d->category,
+                               &d->manufacturerName, &d->version, &d->fileOrIdentifier })
+            out.writeString (*s);
+
+        out.writeInt64 (d->lastFileModTime.toMilliseconds());
+        out.writeInt64 (d->lastInfoUpdateTime.toMilliseconds());
+        out.writeInt (d->deprecatedUid);
+        out.writeInt (d->uniqueId);
+        out.writeInt (d->numInputChannels);
+        out.writeInt (d->numOutputChannels);
+        out.writeBool (d->isInstrument);
+        out.writeBool (d->hasSharedContainer);
+        out.writeBool (d->hasARAExtension);
+    }
+
+    out.flush();
+    return block;
+}
+
+bool PluginDescriptionCodec::decode (const MemoryBlock& block, std::vector<PluginDescription>& result)
+{
+    MemoryInputStream in (block, false);
+    char header[4] = {};
+
+    if (in.read (header, 4) != 4 || std::memcmp (header, magic, 4) != 0 || in.readInt() != version)
+        return false;
+
+    const auto count = in.readInt();
+
+    if (count < 0 || count * minEncodedSize > in.getNumBytesRemaining())
+        return false;
+
+    const auto originalSize = result.size();
+    result.reserve (originalSize + (size_t) count);
+
+    // the stream quietly returns empty strings and zeros once it runs out, which would
+    // otherwise turn a truncated reply into plausible-looking descriptions
+    const auto fail = [&]
+    {
+        result.resize (originalSize);
+        return false;
+    };
+
+    for (int i = 0; i < count; ++i)
+    {
+        auto& d = result.emplace_back();
+
+        for (auto* s : { &d.name, &d.descriptiveName, &d.pluginFormatName, &d.category,
+                         &d.manufacturerName, &d.version, &d.fileOrIdentifier })
+            *s = in.readString();
+
+        if (in.getNumBytesRemaining() < fixedFieldsSize)
+            return fail();
+
+        d.lastFileModTime    = Time (in.readInt64());
+        d.lastInfoUpdateTime = Time (in.readInt64());
+        d.deprecatedUid      = in.readInt();
+        d.uniqueId           = in.readInt();
+        d.numInputChannels   = in.readInt();
+        d.numOutputChannels  = in.readInt();
+        d.isInstrument       = in.readBool();
+        d.hasSharedContainer = in.readBool();
+        d.hasARAExtension    = in.readBool();
+    }
+
+    if (in.getNumBytesRemaining() != 0)
+        return fail();
+
+    return true;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/**
+    The binary form in which the scanner subprocess sends the plug-ins it found
+    back to the host; quicker to write and read than XML for shells that contain
+    hundreds of plug-ins. It's only meant for processes of the same build to
+    talk to each other: anything kept on disk is still XML.
+
+        "PDSC", int32 version, int32 number of descriptions, then for each one
+        its fields in a fixed order, strings as null-terminated UTF-8
+
+    All numbers are little-endian.
+*/
+struct PluginDescriptionCodec
+{
+    static constexpr int32 version = 1;
+
+    static MemoryBlock encode (const OwnedArray<PluginDescription>&);
+
+    /** Returns false if the block isn't a list in this version of the encoding. */
+    static bool decode (const MemoryBlock&, std::vector<PluginDescription>& result);
+};
@@ -51,14 +51,23 @@ PluginGraph::PluginGraph (AudioPluginFormatManager& fm, KnownPluginList& kpl)
                          "Load a graph",
                          "Save a graph"),
       formatManager (fm),
-      knownPlugins (kpl)
+      knownPlugins (kpl),
+      loader (fm, kpl)
 {
+    loader.makeDPIAwarenessDisabler = makeDPIAwarenessDisablerForPlugin;
+
+    // every change to the graph ends up in one of our own change messages, loads included
+    addChangeListener (this);
+
     newDocument();
     graph.addListener (this);
 }
 
 PluginGraph::~PluginGraph()
 {
+    removeChangeListener (this);
+    knownNodes.clear();
+    pendingLoad = nullptr;
     graph.removeListener (this);
     graph.removeChangeListener (this);
     graph.clear();
@@ -70,8 +79,14 @@ PluginGraph::NodeID PluginGraph::getNextUID() noexcept
 }
 
 //==============================================================================
-void PluginGraph::changeListenerCallback (ChangeBroadcaster*)
+void PluginGraph::changeListenerCallback (ChangeBroadcaster* source)
 {
+    if (source == this)
+    {
+        sendTopologyChanges();
+        return;
+    }
+
     changed();
 
     for (int i = activePluginWindows.size(); --i >= 0;)
@@ -79,11 +94,115 @@ void PluginGraph::changeListenerCallback (ChangeBroadcaster*)
             activePluginWindows.remove (i);
 }
 
-AudioProcessorGraph::Node::Ptr PluginGraph::getNodeForName (const String& name) const
+void PluginGraph::addListener (Listener* l)
+{
+    listeners.add (l);
+}
+
+void PluginGraph::removeListener (Listener* l)
+{
+    listeners.remove (l);
+}
+
+void PluginGraph::sendTopologyChanges()
+{
+    std::unordered_map<uint32, AudioProcessorGraph::Node::Ptr> nodesNow;
+    nodesNow.reserve ((size_t) graph.getNodes().size());
+
+    for (auto* node : graph.getNodes())
+        nodesNow.emplace (node->nodeID.uid, node);
+
+    const auto isKnown = [this] (const AudioProcessorGraph::Node* node)
+    {
+        const auto found = knownNodes.find (node->nodeID.uid);
+        return found != knownNodes.end() && found->second.get() == node;
+    };
+
+    const auto connections = graph.getConnections();
+    std::unordered_set<AudioProcessorGraph::Connection, ConnectionHash> connectionsNow (connections.begin(), connections.end());
+
+    // removals first, so nobody is told about a connection to a node that's already gone
+    for (auto& c : knownConnections)
+        if (connectionsNow.count (c) == 0)
+            listeners.call ([&c] (Listener& l) { l.connectionRemoved (c); });
+
+    for (auto& [uid, node] : knownNodes)
+    {
+        const auto found = nodesNow.find (uid);
+
+        if (found == nodesNow.end() || found->second != node)
+        {
+            unindexNodeName (*node);
+            listeners.call ([id = NodeID (uid)] (Listener& l) { l.nodeRemoved (id); });
+        }
+    }
+
+    for (auto* node : graph.getNodes())
+    {
+        if (! isKnown (node))
+        {
+            indexNodeName (*node);
+            listeners.call ([id = node->nodeID] (Listener& l) { l.nodeAdded (id); });
+        }
+    }
+
+    for (auto& c : connections)
+        if (knownConnections.count (c) == 0)
+            listeners.call ([&c] (Listener& l) { l.connectionAdded (c); });
+
+    knownNodes = std::move (nodesNow);
+    knownConnections = std::move (connectionsNow);
+
+    if (namesHaveChanged.exchange (false))
+        rebuildNameIndex();
+
+    if (pluginsHaveChanged.exchange (false))
+        listeners.call ([] (Listener& l) { l.pluginsChanged(); });
+}
+
+void PluginGraph::indexNodeName (const AudioProcessorGraph::Node& node)
 {
+    if (auto* p = node.getProcessor())
+        nodesByName[p->getName().toLowerCase()].insert (node.nodeID.uid);
+}
+
+void PluginGraph::unindexNodeName (const AudioProcessorGraph::Node& node)
+{
+    if (auto* p = node.getProcessor())
+    {
+        const auto found = nodesByName.find (p->getName().toLowerCase());
+
+        if (found != nodesByName.end())
+        {
+            // another node may have taken this ID over and already been indexed under the same name
+            if (graph.getNodeForId (node.nodeID) == nullptr)
+                found->second.erase (node.nodeID.uid);
+
+            if (found->second.empty())
+                nodesByName.erase (found);
+        }
+    }
+}
+
+void PluginGraph::rebuildNameIndex()
+{
+    nodesByName.clear();
+
     for (auto* node : graph.getNodes())
-        if (auto p = node->getProcessor())
-            if (p->getName().equalsIgnoreCase (name))
+        indexNodeName (*node);
+}
+
+AudioProcessorGraph::Node::Ptr PluginGraph::getNodeForName (const String& name) const
+{
+    const auto found = nodesByName.find (name.toLowerCase());
+
+    if (found == nodesByName.end())
+        return nullptr;
+
+    // in ID order, which is the graph's order
+    for (auto uid : found->second)
+        if (auto* node = graph.getNodeForId (NodeID (uid)))
+            if (auto* p = node->getProcessor(); p != nullptr && p->getName().equalsIgnoreCase (name))
                 return node;
 
     return nullptr;
@@ -128,6 +247,7 @@ void PluginGraph::addPluginCallback (std::unique_ptr<AudioPluginInstance> instan
 
         if (auto node = graph.addNode (std::move (instance)))
         {
+            indexNodeName (*node);
             node->properties.set ("x", pos.x);
             node->properties.set ("y", pos.y);
             node->properties.set ("useARA", useARA == PluginDescriptionAndPreference::UseARA::yes);
@@ -142,6 +262,8 @@ void PluginGraph::setNodePosition (NodeID nodeID, Point<double> pos)
     {
         n->properties.set ("x", jlimit (0.0, 1.0, pos.x));
         n->properties.set ("y", jlimit (0.0, 1.0, pos.y));
+
+        listeners.call ([nodeID] (Listener& l) { l.nodeMoved (nodeID); });
     }
 }
 
@@ -212,6 +334,7 @@ String PluginGraph::getDocumentTitle()
 
 void PluginGraph::newDocument()
 {
+    pendingLoad = nullptr;
     clear();
     setFile ({});
 
@@ -235,10 +358,14 @@ void PluginGraph::newDocument()
 
 Result PluginGraph::loadDocument (const File& file)
 {
-    if (auto xml = parseXMLIfTagMatches (file, "FILTERGRAPH"))
+    String error;
+    auto document = FilterGraphFile::read (file, error);
+
+    if (document.xml != nullptr)
     {
+        pendingLoad = nullptr;
         graph.removeChangeListener (this);
-        restoreFromXml (*xml);
+        restoreFromXml (*document.xml, document.blobs.get());
 
         MessageManager::callAsync ([this]
         {
@@ -249,11 +376,87 @@ Result PluginGraph::loadDocument (const File& file)
         return Result::ok();
     }
 
-    return Result::fail ("Not a valid graph file");
+    return Result::fail (error);
+}
+
+void PluginGraph::loadDocumentAsync (const File& file, std::function<void (Result)> callback)
+{
+    String error;
+    auto document = FilterGraphFile::read (file, error);
+
+    if (document.xml == nullptr)
+    {
+        callback (Result::fail (error));
+        return;
+    }
+
+    pendingLoad = nullptr;
+    graph.removeChangeListener (this);
+
+    // the old graph keeps playing until every plug-in of the new one has been created
+    pendingLoad = std::make_unique<AsyncFilterGraphLoad> (loader, graph, std::move (document), [this, callback] (Result result)
+    {
+        changed();
+
+        // a cancelled load leaves the old graph, and whether it had unsaved changes, as they were
+        MessageManager::callAsync ([this, loaded = result.wasOk()]
+        {
+            if (loaded)
+                setChangedFlag (false);
+
+            graph.addChangeListener (this);
+
+            if (pendingLoad != nullptr && pendingLoad->isFinished())
+                pendingLoad = nullptr;
+        });
+
+        if (result.wasOk() && ! pendingLoad->getFailures().isEmpty())
+        {
+            auto options = MessageBoxOptions::makeOptionsOk (MessageBoxIconType::WarningIcon,
+                                                             TRANS ("Some plugins couldn't be loaded"),
+                                                             pendingLoad->getFailures().joinIntoString ("\n"));
+            messageBox = AlertWindow::showScopedAsync (options, nullptr);
+        }
+
+        callback (result);
+    });
+
+    pendingLoad->beforeReplacingGraph = [this] { closeAnyOpenPluginWindows(); };
+    pendingLoad->onNodeAdded = [this] (AudioProcessorGraph::Node& node, const XmlElement& xml)
+    {
+        indexNodeName (node);
+        restoreWindowsFromXml (node, xml);
+    };
+
+    changed();
+}
+
+bool PluginGraph::isLoading() const
+{
+    return pendingLoad != nullptr && ! pendingLoad->isFinished();
+}
+
+double PluginGraph::getLoadProgress() const
+{
+    return pendingLoad != nullptr ? pendingLoad->getProgress() : 1.0;
+}
+
+void PluginGraph::cancelLoading()
+{
+    if (pendingLoad != nullptr)
+        pendingLoad->cancel();
 }
 
 Result PluginGraph::saveDocument (const File& file)
 {
+    if (getAppProperties().getUserSettings()->getBoolValue ("saveBinaryGraphFiles", false))
+    {
+        std::vector<MemoryBlock> states;
+        auto structure = createXml (&states);
+
+        return FilterGraphFile::writeBinary (file, *structure, states);
+    }
+
     auto xml = createXml();
 
     if (! xml->writeTo (file, {}))
@@ -283,47 +486,6 @@ void PluginGraph::setLastDocumentOpened (const File& file)
         ->setValue ("recentFilterGraphFiles", recentFiles.toString());
 }
 
-//==============================================================================
-static void readBusLayoutFromXml (AudioProcessor::BusesLayout& busesLayout, AudioProcessor& plugin,
-                                  const XmlElement& xml, bool isInput)
-{
-    auto& targetBuses = (isInput ? busesLayout.inputBuses
-                                 : busesLayout.outputBuses);
-    int maxNumBuses = 0;
-
-    if (auto* buses = xml.getChildByName (isInput ? "INPUTS" : "OUTPUTS"))
-    {
-        for (auto* e : buses->getChildWithTagNameIterator ("BUS"))
-        {
-            const int busIdx = e->getIntAttribute ("index");
-            maxNumBuses = jmax (maxNumBuses, busIdx + 1);
-
-            // the number of buses on busesLayout may not be in sync with the plugin after adding buses
-            // because adding an input bus could also add an output bus
-            for (int actualIdx = plugin.getBusCount (isInput) - 1; actualIdx < busIdx; ++actualIdx)
-                if (! plugin.addBus (isInput))
-                    return;
-
-            for (int actualIdx = targetBuses.size() - 1; actualIdx < busIdx; ++actualIdx)
-                targetBuses.add (plugin.getChannelLayoutOfBus (isInput, busIdx));
-
-            auto layout = e->getStringAttribute ("layout");
-
-            if (layout.isNotEmpty())
-                targetBuses.getReference (busIdx) = AudioChannelSet::fromAbbreviatedString (layout);
-        }
-    }
-
-    // if the plugin has more buses than specified in the xml, then try to remove them!
-    while (maxNumBuses < targetBuses.size())
-    {
-        if (! plugin.removeBus (isInput))
-            return;
-
-        targetBuses.removeLast();
-    }
-}
-
 //==============================================================================
 static XmlElement* createBusLayoutXml (const AudioProcessor::BusesLayout& layout, const bool isInput)
 {
@@ -344,7 +506,7 @@ static XmlElement* createBusLayoutXml (const AudioProcessor::BusesLayout& layout
     return xml;
 }
 
-static XmlElement* createNodeXml (AudioProcessorGraph::Node* const node) noexcept
+static XmlElement* createNodeXml (AudioProcessorGraph::Node* const node, std::vector<MemoryBlock>* states) noexcept
 {
     if (auto* plugin = dynamic_cast<AudioPluginInstance*> (node->getProcessor()))
     {
@@ -376,7 +538,16 @@ static XmlElement* createNodeXml (AudioProcessorGraph::Node* const node) noexcep
         {
             MemoryBlock m;
             node->getProcessor()->getStateInformation (m);
-            e->createNewChildElement ("STATE")->addTextElement (m.toBase64Encoding());
+
+            if (states != nullptr)
+            {
+                e->createNewChildElement ("STATE")->setAttribute ("blob", (int) states->size());
+                states->push_back (std::move (m));
+            }
+            else
+            {
+                e->createNewChildElement ("STATE")->addTextElement (m.toBase64Encoding());
+            }
         }
 
         auto layout = plugin->getBusesLayout();
@@ -392,121 +563,46 @@ static XmlElement* createNodeXml (AudioProcessorGraph::Node* const node) noexcep
     return nullptr;
 }
 
-void PluginGraph::createNodeFromXml (const XmlElement& xml)
+void PluginGraph::createNodeFromXml (const XmlElement& xml, const FilterGraphStateBlobs* blobs)
 {
-    PluginDescriptionAndPreference pd;
-    const auto nodeUsesARA = xml.getBoolAttribute ("useARA");
+    String error;
 
-    for (auto* e : xml.getChildIterator())
+    if (auto node = loader.createNode (graph, xml, error, blobs))
     {
-        if (pd.pluginDescription.loadFromXml (*e))
-        {
-            pd.useARA = nodeUsesARA ? PluginDescriptionAndPreference::UseARA::yes
-                                    : PluginDescriptionAndPreference::UseARA::no;
-            break;
-        }
+        indexNodeName (*node);
+        restoreWindowsFromXml (*node, xml);
     }
+}
 
-    auto createInstanceWithFallback = [&]() -> std::unique_ptr<AudioPluginInstance>
+void PluginGraph::restoreWindowsFromXml (AudioProcessorGraph::Node& node, const XmlElement& xml)
+{
+    for (int i = 0; i < (int) PluginWindow::Type::numTypes; ++i)
     {
-        auto createInstance = [this] (const PluginDescriptionAndPreference& description) -> std::unique_ptr<AudioPluginInstance>
-        {
-            String errorMessage;
-
-            auto localDpiDisabler = makeDPIAwarenessDisablerForPlugin (description.pluginDescription);
-
-            auto instance = formatManager.createPluginInstance (description.pluginDescription,
-                                                                graph.getSampleRate(),
-                                                                graph.getBlockSize(),
-                                                                errorMessage);
-
-           #if JUCE_PLUGINHOST_ARA && (JUCE_MAC || JUCE_WINDOWS || JUCE_LINUX)
-            if (instance
-                && description.useARA == PluginDescriptionAndPreference::UseARA::yes
-                && description.pluginDescription.hasARAExtension)
-            {
-                return std::make_unique<ARAPluginInstanceWrapper> (std::move (instance));
-            }
-           #endif
-
-            return instance;
-        };
-
-        if (auto instance = createInstance (pd))
-            return instance;
+        auto type = (PluginWindow::Type) i;
 
-        const auto allFormats = formatManager.getFormats();
-        const auto matchingFormat = std::find_if (allFormats.begin(), allFormats.end(),
-                                                  [&] (const AudioPluginFormat* f) { return f->getName() == pd.pluginDescription.pluginFormatName; });
-
-        if (matchingFormat == allFormats.end())
-            return nullptr;
-
-        const auto plugins = knownPlugins.getTypesForFormat (**matchingFormat);
-        const auto matchingPlugin = std::find_if (plugins.begin(), plugins.end(),
-                                                  [&] (const PluginDescription& desc) { return pd.pluginDescription.uniqueId == desc.uniqueId; });
-
-        if (matchingPlugin == plugins.end())
-            return nullptr;
-
-        return createInstance (PluginDescriptionAndPreference { *matchingPlugin });
-    };
-
-    if (auto instance = createInstanceWithFallback())
-    {
-        if (auto* layoutEntity = xml.getChildByName ("LAYOUT"))
+        if (xml.hasAttribute (PluginWindow::getOpenProp (type)))
         {
-            auto layout = instance->getBusesLayout();
-
-            readBusLayoutFromXml (layout, *instance, *layoutEntity, true);
-            readBusLayoutFromXml (layout, *instance, *layoutEntity, false);
-
-            instance->setBusesLayout (layout);
-        }
+            node.properties.set (PluginWindow::getLastXProp (type), xml.getIntAttribute (PluginWindow::getLastXProp (type)));
+            node.properties.set (PluginWindow::getLastYProp (type), xml.getIntAttribute (PluginWindow::getLastYProp (type)));
+            node.properties.set (PluginWindow::getOpenProp  (type), xml.getIntAttribute (PluginWindow::getOpenProp (type)));
 
-        if (auto node = graph.addNode (std::move (instance), NodeID ((uint32) xml.getIntAttribute ("uid"))))
-        {
-            if (auto* state = xml.getChildByName ("STATE"))
+            if (node.properties[PluginWindow::getOpenProp (type)])
             {
-                MemoryBlock m;
-                m.fromBase64Encoding (state->getAllSubText());
+                jassert (node.getProcessor() != nullptr);
 
-                node->getProcessor()->setStateInformation (m.getData(), (int) m.getSize());
-            }
-
-            node->properties.set ("x", xml.getDoubleAttribute ("x"));
-            node->properties.set ("y", xml.getDoubleAttribute ("y"));
-            node->properties.set ("useARA", xml.getBoolAttribute ("useARA"));
-
-            for (int i = 0; i < (int) PluginWindow::Type::numTypes; ++i)
-            {
-                auto type = (PluginWindow::Type) i;
-
-                if (xml.hasAttribute (PluginWindow::getOpenProp (type)))
-                {
-                    node->properties.set (PluginWindow::getLastXProp (type), xml.getIntAttribute (PluginWindow::getLastXProp (type)));
-                    node->properties.set (PluginWindow::getLastYProp (type), xml.getIntAttribute (PluginWindow::getLastYProp (type)));
-                    node->properties.set (PluginWindow::getOpenProp  (type), xml.getIntAttribute (PluginWindow::getOpenProp (type)));
-
-                    if (node->properties[PluginWindow::getOpenProp (type)])
-                    {
-                        jassert (node->getProcessor() != nullptr);
-
-                        if (auto w = getOrCreateWindowFor (node, type))
-                            w->toFront (true);
-                    }
-                }
+                if (auto w = getOrCreateWindowFor (&node, type))
+                    w->toFront (true);
             }
         }
     }
 }
 
-std::unique_ptr<XmlElement> PluginGraph::createXml() const
+std::unique_ptr<XmlElement> PluginGraph::createXml (std::vector<MemoryBlock>* states) const
 {
     auto xml = std::make_unique<XmlElement> ("FILTERGRAPH");
 
     for (auto* node : graph.getNodes())
-        xml->addChildElement (createNodeXml (node));
+        xml->addChildElement (createNodeXml (node, states));
 
     for (auto& connection : graph.getConnections())
     {
@@ -521,23 +617,17 @@ std::unique_ptr<XmlElement> PluginGraph::createXml() const
     return xml;
 }
 
-void PluginGraph::restoreFromXml (const XmlElement& xml)
+void PluginGraph::restoreFromXml (const XmlElement& xml, const FilterGraphStateBlobs* blobs)
 {
     clear();
 
     for (auto* e : xml.getChildWithTagNameIterator ("FILTER"))
     {
-        createNodeFromXml (*e);
+        createNodeFromXml (*e, blobs);
         changed();
     }
 
-    for (auto* e : xml.getChildWithTagNameIterator ("CONNECTION"))
-    {
-        graph.addConnection ({ { NodeID ((uint32) e->getIntAttribute ("srcFilter")), e->getIntAttribute ("srcChannel") },
-                               { NodeID ((uint32) e->getIntAttribute ("dstFilter")), e->getIntAttribute ("dstChannel") } });
-    }
-
-    graph.removeIllegalConnections();
+    FilterGraphLoader::restoreConnections (graph, xml);
 }
 
 File PluginGraph::getDefaultGraphDocumentOnMobile()
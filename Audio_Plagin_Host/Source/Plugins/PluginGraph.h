@@ -35,30 +35,7 @@
 #pragma once
 
 #include "../UI/PluginWindow.h"
-
-//==============================================================================
-/** A type that encapsulates a PluginDescription and some preferences regarding
-    how plugins of that description should be instantiated.
-*/
-struct PluginDescriptionAndPreference
-{
-    enum class UseARA { no, yes };
-
-    PluginDescriptionAndPreference() = default;
-
-    explicit PluginDescriptionAndPreference (PluginDescription pd)
-        : pluginDescription (std::move (pd)),
-          useARA (pluginDescription.hasARAExtension ? PluginDescriptionAndPreference::UseARA::yes
-                                                    : PluginDescriptionAndPreference::UseARA::no)
-    {}
-
-    PluginDescriptionAndPreference (PluginDescription pd, UseARA ara)
-        : pluginDescription (std::move (pd)), useARA (ara)
-    {}
-
-    PluginDescription pluginDescription;
-    UseARA useARA = UseARA::no;
-};
+#include "FilterGraphLoader.h"
 
 //==============================================================================
 /**
@@ -83,6 +60,38 @@ public:
     void setNodePosition (NodeID, Point<double>);
     Point<double> getNodePosition (NodeID) const;
 
+    //==============================================================================
+    /** Receives each node and connection that's been added or removed, on the message
+        thread, so a view can update just the parts of the graph that changed.
+    */
+    struct Listener
+    {
+        virtual ~Listener() = default;
+
+        virtual void nodeAdded (NodeID) {}
+        virtual void nodeRemoved (NodeID) {}
+        virtual void nodeMoved (NodeID) {}
+        virtual void connectionAdded (const AudioProcessorGraph::Connection&) {}
+        virtual void connectionRemoved (const AudioProcessorGraph::Connection&) {}
+
+        // a plug-in's name, channels or buses may have changed
+        virtual void pluginsChanged() {}
+    };
+
+    void addListener (Listener*);
+    void removeListener (Listener*);
+
+    struct ConnectionHash
+    {
+        size_t operator() (const AudioProcessorGraph::Connection& c) const noexcept
+        {
+            return (size_t) c.source.nodeID.uid * 0x9e3779b1u
+                 ^ (size_t) c.destination.nodeID.uid * 0x85ebca77u
+                 ^ (size_t) (uint32) c.source.channelIndex << 16
+                 ^ (size_t) (uint32) c.destination.channelIndex;
+        }
+    };
+
     //==============================================================================
     void clear();
 
@@ -92,11 +101,21 @@ public:
 
     //==============================================================================
     void audioProcessorParameterChanged (AudioProcessor*, int, float) override {}
-    void audioProcessorChanged (AudioProcessor*, const ChangeDetails&) override { changed(); }
+    void audioProcessorChanged (AudioProcessor*, const ChangeDetails& details) override
+    {
+        if (details.nameChanged)
+            namesHaveChanged = true;
+
+        pluginsHaveChanged = true;
+        changed();
+    }
 
     //==============================================================================
-    std::unique_ptr<XmlElement> createXml() const;
-    void restoreFromXml (const XmlElement&);
+    /** If states isn't null, each plug-in's state is moved into it and its STATE
+        element only refers to it, as a binary document stores them.
+    */
+    std::unique_ptr<XmlElement> createXml (std::vector<MemoryBlock>* states = nullptr) const;
+    void restoreFromXml (const XmlElement&, const FilterGraphStateBlobs* blobs = nullptr);
 
     static const char* getFilenameSuffix()      { return ".filtergraph"; }
     static const char* getFilenameWildcard()    { return "*.filtergraph"; }
@@ -105,12 +124,17 @@ public:
     void newDocument();
     String getDocumentTitle() override;
     Result loadDocument (const File& file) override;
+    void loadDocumentAsync (const File& file, std::function<void (Result)> callback) override;
     Result saveDocument (const File& file) override;
     File getLastDocumentOpened() override;
     void setLastDocumentOpened (const File& file) override;
 
     static File getDefaultGraphDocumentOnMobile();
 
+    bool isLoading() const;
+    double getLoadProgress() const;
+    void cancelLoading();
+
     //==============================================================================
     AudioProcessorGraph graph;
 
@@ -118,13 +142,32 @@ private:
     //==============================================================================
     AudioPluginFormatManager& formatManager;
     KnownPluginList& knownPlugins;
+    FilterGraphLoader loader;
+    std::unique_ptr<AsyncFilterGraphLoad> pendingLoad;
     OwnedArray<PluginWindow> activePluginWindows;
     ScopedMessageBox messageBox;
 
     NodeID lastUID;
     NodeID getNextUID() noexcept;
 
-    void createNodeFromXml (const XmlElement&);
+    // what the listeners have been told about so far; a loaded graph can reuse an ID for a different node
+    ListenerList<Listener> listeners;
+    std::unordered_map<uint32, AudioProcessorGraph::Node::Ptr> knownNodes;
+    std::unordered_set<AudioProcessorGraph::Connection, ConnectionHash> knownConnections;
+    std::atomic<bool> pluginsHaveChanged { false };
+
+    // lower-case plug-in name -> the IDs of the nodes with that name; lookups check the
+    // node is still there and still called that, so it only has to be right eventually
+    std::unordered_map<String, std::set<uint32>> nodesByName;
+    std::atomic<bool> namesHaveChanged { false };
+
+    void sendTopologyChanges();
+    void indexNodeName (const AudioProcessorGraph::Node&);
+    void unindexNodeName (const AudioProcessorGraph::Node&);
+    void rebuildNameIndex();
+
+    void createNodeFromXml (const XmlElement&, const FilterGraphStateBlobs*);
+    void restoreWindowsFromXml (AudioProcessorGraph::Node&, const XmlElement&);
     void addPluginCallback (std::unique_ptr<AudioPluginInstance>,
                             const String& error,
                             Point<double>,
@@ -0,0 +1,132 @@
+#include <JuceHeader.h>
+#include "PluginScanCache.h"
+
+static constexpr int cacheVersion = 1;
+
+//==============================================================================
+PluginScanCache::PluginScanCache (File cacheFile)
+    : file (std::move (cacheFile))
+{
+}
+
+std::optional<PluginScanCache::Signature> PluginScanCache::getSignature (const String& fileOrIdentifier)
+{
+    if (! File::isAbsolutePath (fileOrIdentifier))
+        return {};
+
+    const File f (fileOrIdentifier);
+
+    if (f.existsAsFile())
+        return Signature { f.getSize(), f.getLastModificationTime().toMilliseconds() };
+
+    if (! f.isDirectory())
+        return {};
+
+    Signature signature;
+
+    for (const auto& entry : RangedDirectoryIterator (f, true, "*", File::findFiles))
+    {
+        signature.size += entry.getFileSize();
+        signature.modified = jmax (signature.modified, entry.getModificationTime().toMilliseconds());
+    }
+
+    return signature;
+}
+
+String PluginScanCache::makeKey (const String& formatName, const String& fileOrIdentifier)
+{
+    return formatName + "|" + fileOrIdentifier;
+}
+
+bool PluginScanCache::lookup (const String& formatName, const String& fileOrIdentifier, OwnedArray<PluginDescription>& result)
+{
+    const auto signature = getSignature (fileOrIdentifier);
+
+    if (! signature.has_value())
+        return false;
+
+    const ScopedLock sl (lock);
+    loadIfNeeded();
+
+    const auto found = entries.find (makeKey (formatName, fileOrIdentifier));
+
+    if (found == entries.end() || ! (found->second.signature == *signature))
+        return false;
+
+    for (auto& desc : found->second.descriptions)
+        result.add (std::make_unique<PluginDescription> (desc));
+
+    return true;
+}
+
+void PluginScanCache::store (const String& formatName, const String& fileOrIdentifier, const OwnedArray<PluginDescription>& found)
+{
+    const auto signature = getSignature (fileOrIdentifier);
+
+    if (! signature.has_value())
+        return;
+
+    Entry entry { *signature, {} };
+
+    for (auto* desc : found)
+        entry.descriptions.push_back (*desc);
+
+    const ScopedLock sl (lock);
+    loadIfNeeded();
+
+    entries[makeKey (formatName, fileOrIdentifier)] = std::move (entry);
+    hasChanged = true;
+}
+
+void PluginScanCache::loadIfNeeded()
+{
+    if (std::exchange (loaded, true))
+        return;
+
+    const auto xml = parseXMLIfTagMatches (file, "PLUGINSCANCACHE");
+
+    if (xml == nullptr || xml->getIntAttribute ("version") != cacheVersion)
+        return;
+
+    for (auto* e : xml->getChildWithTagNameIterator ("FILE"))
+    {
+        Entry entry;
+        entry.signature.size     = e->getStringAttribute ("size").getLargeIntValue();
+        entry.signature.modified = e->getStringAttribute ("modified").getLargeIntValue();
+
+        for (auto* item : e->getChildIterator())
+        {
+            PluginDescription desc;
+
+            if (desc.loadFromXml (*item))
+                entry.descriptions.push_back (std::move (desc));
+        }
+
+        entries[makeKey (e->getStringAttribute ("format"), e->getStringAttribute ("path"))] = std::move (entry);
+    }
+}
+
+void PluginScanCache::save()
+{
+    const ScopedLock sl (lock);
+
+    if (! std::exchange (hasChanged, false))
+        return;
+
+    XmlElement xml ("PLUGINSCANCACHE");
+    xml.setAttribute ("version", cacheVersion);
+
+    for (auto& [key, entry] : entries)
+    {
+        auto* e = xml.createNewChildElement ("FILE");
+        e->setAttribute ("format",   key.upToFirstOccurrenceOf ("|", false, false));
+        e->setAttribute ("path",     key.fromFirstOccurrenceOf ("|", false, false));
+        e->setAttribute ("size",     String (entry.signature.size));
+        e->setAttribute ("modified", String (entry.signature.modified));
+
+        for (auto& desc : entry.descriptions)
+            e->addChildElement (desc.createXml().release());
+    }
+
+    xml.writeTo (file, {});
+}
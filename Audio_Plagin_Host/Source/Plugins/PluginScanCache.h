@@ -0,0 +1,56 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/**
+    Remembers what scanning each plug-in file found, so a rescan only has to
+    look at files that are new or have changed since.
+
+    Entries are keyed by format and file, and only count as valid while the
+    file's size and modification time are what they were when it was scanned;
+    a bundle counts as the total size and newest modification time of the
+    files inside it. Identifiers that aren't files, such as AudioUnit IDs, are
+    never cached. Files in which nothing was found are remembered too.
+
+    It may be used from several scanning threads at once.
+*/
+class PluginScanCache final
+{
+public:
+    explicit PluginScanCache (File cacheFile);
+
+    /** If the file hasn't changed since it was last scanned with this format, adds what that scan found. */
+    bool lookup (const String& formatName, const String& fileOrIdentifier, OwnedArray<PluginDescription>& result);
+
+    void store (const String& formatName, const String& fileOrIdentifier, const OwnedArray<PluginDescription>& found);
+
+    /** Writes the cache back to its file, if anything has changed. */
+    void save();
+
+private:
+    struct Signature
+    {
+        int64 size = 0, modified = 0;
+
+        bool operator== (const Signature& other) const noexcept { return size == other.size && modified == other.modified; }
+    };
+
+    struct Entry
+    {
+        Signature signature;
+        std::vector<PluginDescription> descriptions;
+    };
+
+    static std::optional<Signature> getSignature (const String& fileOrIdentifier);
+    static String makeKey (const String& formatName, const String& fileOrIdentifier);
+
+    void loadIfNeeded();
+
+    const File file;
+    CriticalSection lock;
+    std::unordered_map<String, Entry> entries;
+    bool loaded = false, hasChanged = false;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PluginScanCache)
+};
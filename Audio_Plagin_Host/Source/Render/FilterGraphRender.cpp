@@ -0,0 +1,223 @@
+#include <JuceHeader.h>
+#include "../Plugins/FilterGraphLoader.h"
+#include "../Plugins/InternalPlugins.h"
+#include "../Plugins/ParallelGraphRenderer.h"
+
+//==============================================================================
+/*
+    Renders a .filtergraph without an audio device: the graph's Audio Input
+    node reads from a file (or silence), its Audio Output node is written to a
+    file, and blocks are processed as fast as the plug-ins allow, in
+    non-realtime mode. Prints the throughput as a multiple of real time.
+*/
+static const char* const helpText = R"(Options:
+    --input|-i <file>        audio file fed to the Audio Input node (silence if omitted)
+    --output|-o <file>       audio file written from the Audio Output node (nothing written if omitted)
+    --length <seconds>       length to render without an input file (default 10)
+    --tail <seconds>         extra time rendered after the input ends (default 0)
+    --sample-rate <hz>       defaults to the input file's rate, or 48000
+    --block-size <samples>   default 512
+    --channels <n>           channels of the graph's audio input and output (default 2)
+    --bits <n>               output bit depth (default 24)
+    --threads <n>            worker threads for independent plug-ins (default 0: serial)
+    --plugin-list <file>     known plug-ins, as saved by the host; defaults to the host's settings
+    --allow-missing          render even if some plug-ins can't be created)";
+
+static void loadKnownPlugins (KnownPluginList& knownPlugins, const ArgumentList& args)
+{
+    if (args.containsOption ("--plugin-list"))
+    {
+        if (auto xml = parseXML (args.getExistingFileForOption ("--plugin-list")))
+            knownPlugins.recreateFromXml (*xml);
+
+        return;
+    }
+
+    // the same file the host keeps its settings in
+    PropertiesFile::Options options;
+    options.applicationName     = "Juce Audio Plugin Host";
+    options.filenameSuffix      = "settings";
+    options.osxLibrarySubFolder = "Preferences";
+
+    PropertiesFile settings (options);
+
+    if (auto xml = settings.getXmlValue ("pluginList"))
+        knownPlugins.recreateFromXml (*xml);
+}
+
+static std::unique_ptr<AudioFormatWriter> createWriter (AudioFormatManager& audioFormats, const File& file,
+                                                        double sampleRate, int numChannels, int bitsPerSample)
+{
+    auto* format = audioFormats.findFormatForFileExtension (file.getFileExtension());
+
+    if (format == nullptr)
+        ConsoleApplication::fail ("No audio format for " + file.getFullPathName());
+
+    file.deleteFile();
+    auto out = file.createOutputStream();
+
+    if (out == nullptr)
+        ConsoleApplication::fail ("Couldn't write to " + file.getFullPathName());
+
+    std::unique_ptr<AudioFormatWriter> writer (format->createWriterFor (out.get(), sampleRate, (unsigned int) numChannels,
+                                                                        bitsPerSample, {}, 0));
+
+    if (writer == nullptr)
+        ConsoleApplication::fail ("Can't write " + String (numChannels) + " channels of " + String (bitsPerSample)
+                                    + " bits at " + String (sampleRate) + " Hz to " + file.getFullPathName());
+
+    out.release();  // the writer owns it now
+    return writer;
+}
+
+static void render (const ArgumentList& args)
+{
+    const ScopedJuceInitialiser_GUI juceInitialiser;
+
+    args.checkMinNumArguments (1);
+    const auto graphFile = args[0].resolveAsExistingFile();
+
+    AudioFormatManager audioFormats;
+    audioFormats.registerBasicFormats();
+
+    std::unique_ptr<AudioFormatReader> reader;
+
+    if (args.containsOption ("--input|-i"))
+    {
+        const auto inputFile = args.getExistingFileForOption ("--input|-i");
+        reader.reset (audioFormats.createReaderFor (inputFile));
+
+        if (reader == nullptr)
+            ConsoleApplication::fail ("Can't read " + inputFile.getFullPathName());
+    }
+
+    const auto optionOr = [&args] (StringRef option, double fallback)
+    {
+        return args.containsOption (option) ? args.getValueForOption (option).getDoubleValue() : fallback;
+    };
+
+    const auto sampleRate  = optionOr ("--sample-rate", reader != nullptr ? reader->sampleRate : 48000.0);
+    const auto blockSize   = (int) optionOr ("--block-size", 512);
+    const auto numChannels = (int) optionOr ("--channels", 2);
+    const auto numThreads  = (int) optionOr ("--threads", 0);
+
+    if (sampleRate <= 0 || blockSize <= 0 || numChannels <= 0)
+        ConsoleApplication::fail ("The sample rate, block size and channel count must be positive");
+
+    const auto inputLength = reader != nullptr ? reader->lengthInSamples
+                                               : (int64) (optionOr ("--length", 10.0) * sampleRate);
+    const auto tailLength = (int64) (optionOr ("--tail", 0.0) * sampleRate);
+
+    //==============================================================================
+    AudioPluginFormatManager pluginFormats;
+    pluginFormats.addDefaultFormats();
+    pluginFormats.addFormat (new InternalPluginFormat());
+
+    KnownPluginList knownPlugins;
+    loadKnownPlugins (knownPlugins, args);
+
+    String readError;
+    const auto document = FilterGraphFile::read (graphFile, readError);
+
+    if (document.xml == nullptr)
+        ConsoleApplication::fail (graphFile.getFullPathName() + ": " + readError);
+
+    // plug-ins are created at the rate and block size they will be played at
+    AudioProcessorGraph graph;
+    graph.setPlayConfigDetails (numChannels, numChannels, sampleRate, blockSize);
+
+    FilterGraphLoader loader (pluginFormats, knownPlugins);
+    const auto loaded = loader.restoreGraph (graph, *document.xml, document.blobs.get());
+
+    if (loaded.failed())
+    {
+        std::cerr << loaded.getErrorMessage() << std::endl;
+
+        if (! args.containsOption ("--allow-missing"))
+            ConsoleApplication::fail ("Some plug-ins in " + graphFile.getFileName() + " couldn't be created");
+    }
+
+    std::unique_ptr<ParallelGraphRenderer> renderer;
+    AudioProcessor* processor = &graph;
+
+    if (numThreads > 0)
+    {
+        ParallelGraphRenderer::Options options;
+        options.numWorkers = numThreads;
+
+        renderer = std::make_unique<ParallelGraphRenderer> (graph, options);
+        processor = renderer.get();
+    }
+
+    processor->setPlayConfigDetails (numChannels, numChannels, sampleRate, blockSize);
+    processor->setNonRealtime (true);
+    processor->prepareToPlay (sampleRate, blockSize);
+
+    // there's no message loop to do these asynchronously
+    graph.rebuild();
+
+    if (renderer != nullptr)
+        renderer->rebuildPlanNow();
+
+    std::unique_ptr<AudioFormatWriter> writer;
+
+    if (args.containsOption ("--output|-o"))
+        writer = createWriter (audioFormats, args.getFileForOption ("--output|-o"), sampleRate, numChannels,
+                               (int) optionOr ("--bits", 24));
+
+    //==============================================================================
+    // the output is shifted back by the graph's latency, so it lines up with the input
+    const auto latency = (int64) processor->getLatencySamples();
+    const auto totalLength = inputLength + tailLength + latency;
+
+    AudioBuffer<float> buffer (numChannels, blockSize);
+    MidiBuffer midi;
+
+    const auto startTime = Time::getMillisecondCounterHiRes();
+
+    for (int64 position = 0; position < totalLength; position += blockSize)
+    {
+        const auto numSamples = (int) jmin ((int64) blockSize, totalLength - position);
+        AudioBuffer<float> block (buffer.getArrayOfWritePointers(), numChannels, numSamples);
+
+        block.clear();
+        midi.clear();
+
+        if (reader != nullptr && position < inputLength)
+            reader->read (&block, 0, (int) jmin ((int64) numSamples, inputLength - position), position, true, true);
+
+        processor->processBlock (block, midi);
+
+        const auto skip = (int) jlimit ((int64) 0, (int64) numSamples, latency - position);
+
+        if (writer != nullptr && skip < numSamples)
+            writer->writeFromAudioSampleBuffer (block, skip, numSamples - skip);
+    }
+
+    const auto elapsedSeconds = (Time::getMillisecondCounterHiRes() - startTime) / 1000.0;
+    const auto renderedSeconds = (double) totalLength / sampleRate;
+
+    processor->releaseResources();
+    writer = nullptr;
+    renderer = nullptr;
+    graph.clear();
+
+    std::cout << graphFile.getFileName() << ": rendered " << String (renderedSeconds, 2) << " s in "
+              << String (elapsedSeconds, 3) << " s, "
+              << String (elapsedSeconds > 0.0 ? renderedSeconds / elapsedSeconds : 0.0, 1) << "x realtime" << std::endl;
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    ConsoleApplication app;
+
+    app.addHelpCommand ("--help|-h", helpText, false);
+    app.addDefaultCommand ({ "",
+                             "<graph.filtergraph> [options]",
+                             "Renders a graph from one audio file to another, faster than real time",
+                             helpText,
+                             render });
+
+    return app.findAndRunCommand (argc, argv);
+}
@@ -250,8 +250,6 @@ struct GraphEditorPanel::PluginComponent final : public Component,
             graph.setNodePosition (pluginID,
                                    { pos.x / (double) getParentWidth(),
                                      pos.y / (double) getParentHeight() });
-
-            panel.updateComponents();
         }
     }
 
@@ -301,10 +299,36 @@ struct GraphEditorPanel::PluginComponent final : public Component,
         g.fillRect (boxArea.toFloat());
 
         g.setColour (findColour (TextEditor::textColourId));
+
+        if (panel.profiler != nullptr)
+            paintTimings (g, boxArea.removeFromBottom (timingsHeight));
+
         g.setFont (font);
         g.drawFittedText (getName(), boxArea, Justification::centred, 2);
     }
 
+    void paintTimings (Graphics& g, Rectangle<int> area)
+    {
+        auto text = String ("-");
+
+        if (auto stats = panel.profiler->getStats (pluginID))
+        {
+            text = String (stats->averageMicros, 1) + " / " + String (stats->p99Micros, 1) + " us  "
+                     + String (stats->percentOfBuffer, 1) + "%";
+
+            // a plug-in taking a quarter of the buffer on its own is worth noticing
+            if (stats->percentOfBuffer > 25.0)
+                g.setColour (Colours::red);
+        }
+
+        if (auto* processor = getProcessor(); processor != nullptr && processor->getLatencySamples() > 0)
+            text << "  " << processor->getLatencySamples() << " smp";
+
+        g.setFont (FontOptions { 11.0f });
+        g.drawFittedText (text, area, Justification::centred, 1);
+        g.setColour (findColour (TextEditor::textColourId));
+    }
+
     void resized() override
     {
         if (auto f = graph.graph.getNodeForId (pluginID))
@@ -366,13 +390,13 @@ struct GraphEditorPanel::PluginComponent final : public Component,
         if (textWidth > 300)
             h = 100;
 
+        if (panel.profiler != nullptr)
+            h += timingsHeight;
+
         setSize (w, h);
         setName (processor.getName() + formatSuffix);
 
-        {
-            auto p = graph.getNodePosition (pluginID);
-            setCentreRelative ((float) p.x, (float) p.y);
-        }
+        updatePosition();
 
         if (numIns != numInputs || numOuts != numOutputs)
         {
@@ -397,6 +421,12 @@ struct GraphEditorPanel::PluginComponent final : public Component,
         }
     }
 
+    void updatePosition()
+    {
+        auto p = graph.getNodePosition (pluginID);
+        setCentreRelative ((float) p.x, (float) p.y);
+    }
+
     AudioProcessor* getProcessor() const
     {
         if (auto node = graph.graph.getNodeForId (pluginID))
@@ -552,6 +582,7 @@ struct GraphEditorPanel::PluginComponent final : public Component,
     OwnedArray<PinComponent> pins;
     int numInputs = 0, numOutputs = 0;
     int pinSize = 16;
+    static constexpr int timingsHeight = 14;
     Point<int> originalPos;
     Font font = FontOptions { 13.0f, Font::bold };
     int numIns = 0, numOuts = 0;
@@ -761,16 +792,28 @@ struct GraphEditorPanel::ConnectorComponent final : public Component,
 //==============================================================================
 GraphEditorPanel::GraphEditorPanel (PluginGraph& g)  : graph (g)
 {
-    graph.addChangeListener (this);
+    graph.addListener (this);
     setOpaque (true);
+
+    // the graph only tells us about what changes from now on
+    for (auto* node : graph.graph.getNodes())
+        nodeAdded (node->nodeID);
+
+    for (auto& connection : graph.graph.getConnections())
+        connectionAdded (connection);
 }
 
 GraphEditorPanel::~GraphEditorPanel()
 {
-    graph.removeChangeListener (this);
+    graph.removeListener (this);
+
+    if (profiler != nullptr)
+        profiler->removeChangeListener (this);
+
     draggingConnector = nullptr;
-    nodes.clear();
+    connectorsByNode.clear();
     connectors.clear();
+    nodes.clear();
 }
 
 void GraphEditorPanel::paint (Graphics& g)
@@ -812,25 +855,13 @@ void GraphEditorPanel::createNewPlugin (const PluginDescriptionAndPreference& de
 
 GraphEditorPanel::PluginComponent* GraphEditorPanel::getComponentForPlugin (AudioProcessorGraph::NodeID nodeID) const
 {
-    for (auto* fc : nodes)
-       if (fc->pluginID == nodeID)
-            return fc;
-
-    return nullptr;
-}
-
-GraphEditorPanel::ConnectorComponent* GraphEditorPanel::getComponentForConnection (const AudioProcessorGraph::Connection& conn) const
-{
-    for (auto* cc : connectors)
-        if (cc->connection == conn)
-            return cc;
-
-    return nullptr;
+    const auto found = nodes.find (nodeID.uid);
+    return found != nodes.end() ? found->second.get() : nullptr;
 }
 
 GraphEditorPanel::PinComponent* GraphEditorPanel::findPinAt (Point<float> pos) const
 {
-    for (auto* fc : nodes)
+    for (auto& [uid, fc] : nodes)
     {
         // NB: A Visual Studio optimiser error means we have to put this Component* in a local
         // variable before trying to cast it, or it gets mysteriously optimised away..
@@ -848,48 +879,133 @@ void GraphEditorPanel::resized()
     updateComponents();
 }
 
-void GraphEditorPanel::changeListenerCallback (ChangeBroadcaster*)
+void GraphEditorPanel::changeListenerCallback (ChangeBroadcaster* source)
+{
+    if (profiler != nullptr && source == profiler)
+    {
+        for (auto& [uid, node] : nodes)
+            node->repaint();
+
+        return;
+    }
+
+    updateComponents();
+}
+
+void GraphEditorPanel::setProfiler (NodeProfiler* newProfiler)
 {
+    if (profiler != nullptr)
+        profiler->removeChangeListener (this);
+
+    profiler = newProfiler;
+
+    if (profiler != nullptr)
+        profiler->addChangeListener (this);
+
     updateComponents();
+
+    for (auto& [uid, node] : nodes)
+        node->repaint();
 }
 
 void GraphEditorPanel::updateComponents()
 {
-    for (int i = nodes.size(); --i >= 0;)
-        if (graph.graph.getNodeForId (nodes.getUnchecked (i)->pluginID) == nullptr)
-            nodes.remove (i);
+    // a node the graph has just dropped stays here until the graph gets round to saying so
+    for (auto& [uid, fc] : nodes)
+        if (graph.graph.getNodeForId (AudioProcessorGraph::NodeID (uid)) != nullptr)
+            fc->update();
 
-    for (int i = connectors.size(); --i >= 0;)
-        if (! graph.graph.isConnected (connectors.getUnchecked (i)->connection))
-            connectors.remove (i);
+    for (auto& [connection, cc] : connectors)
+        cc->update();
+}
 
-    for (auto* fc : nodes)
-        fc->update();
+void GraphEditorPanel::updateConnectorsOf (AudioProcessorGraph::NodeID nodeID)
+{
+    const auto range = connectorsByNode.equal_range (nodeID.uid);
 
-    for (auto* cc : connectors)
-        cc->update();
+    for (auto it = range.first; it != range.second; ++it)
+        it->second->update();
+}
 
-    for (auto* f : graph.graph.getNodes())
+void GraphEditorPanel::nodeAdded (AudioProcessorGraph::NodeID nodeID)
+{
+    if (nodes.count (nodeID.uid) != 0)
+        return;
+
+    auto comp = std::make_unique<PluginComponent> (*this, nodeID);
+    addAndMakeVisible (comp.get());
+    comp->update();
+    nodes.emplace (nodeID.uid, std::move (comp));
+
+    // a node that replaced one with the same ID may have inherited its connectors
+    updateConnectorsOf (nodeID);
+}
+
+void GraphEditorPanel::nodeRemoved (AudioProcessorGraph::NodeID nodeID)
+{
+    nodes.erase (nodeID.uid);
+}
+
+void GraphEditorPanel::nodeMoved (AudioProcessorGraph::NodeID nodeID)
+{
+    if (auto* comp = getComponentForPlugin (nodeID))
     {
-        if (getComponentForPlugin (f->nodeID) == nullptr)
-        {
-            auto* comp = nodes.add (new PluginComponent (*this, f->nodeID));
-            addAndMakeVisible (comp);
-            comp->update();
-        }
+        comp->updatePosition();
+        updateConnectorsOf (nodeID);
     }
+}
+
+void GraphEditorPanel::connectionAdded (const Connection& c)
+{
+    if (connectors.count (c) != 0)
+        return;
 
-    for (auto& c : graph.graph.getConnections())
+    auto comp = std::make_unique<ConnectorComponent> (*this);
+    addAndMakeVisible (comp.get());
+
+    comp->setInput (c.source);
+    comp->setOutput (c.destination);
+
+    connectorsByNode.emplace (c.source.nodeID.uid, comp.get());
+    connectorsByNode.emplace (c.destination.nodeID.uid, comp.get());
+    connectors.emplace (c, std::move (comp));
+}
+
+void GraphEditorPanel::connectionRemoved (const Connection& c)
+{
+    releaseConnector (c);
+}
+
+void GraphEditorPanel::pluginsChanged()
+{
+    updateComponents();
+}
+
+std::unique_ptr<GraphEditorPanel::ConnectorComponent> GraphEditorPanel::releaseConnector (const Connection& c)
+{
+    const auto found = connectors.find (c);
+
+    if (found == connectors.end())
+        return nullptr;
+
+    auto comp = std::move (found->second);
+    connectors.erase (found);
+
+    for (auto uid : { c.source.nodeID.uid, c.destination.nodeID.uid })
     {
-        if (getComponentForConnection (c) == nullptr)
-        {
-            auto* comp = connectors.add (new ConnectorComponent (*this));
-            addAndMakeVisible (comp);
+        const auto range = connectorsByNode.equal_range (uid);
 
-            comp->setInput (c.source);
-            comp->setOutput (c.destination);
+        for (auto it = range.first; it != range.second; ++it)
+        {
+            if (it->second == comp.get())
+            {
+                connectorsByNode.erase (it);
+                break;
+            }
         }
     }
+
+    return comp;
 }
 
 void GraphEditorPanel::showPopupMenu (Point<int> mousePos)
@@ -914,9 +1030,8 @@ void GraphEditorPanel::beginConnectorDrag (AudioProcessorGraph::NodeAndChannel s
                                            AudioProcessorGraph::NodeAndChannel dest,
                                            const MouseEvent& e)
 {
-    auto* c = dynamic_cast<ConnectorComponent*> (e.originalComponent);
-    connectors.removeObject (c, false);
-    draggingConnector.reset (c);
+    if (auto* c = dynamic_cast<ConnectorComponent*> (e.originalComponent))
+        draggingConnector = releaseConnector (c->connection);
 
     if (draggingConnector == nullptr)
         draggingConnector.reset (new ConnectorComponent (*this));
@@ -996,7 +1111,9 @@ void GraphEditorPanel::endDraggingConnector (const MouseEvent& e)
             connection.destination = pin->pin;
         }
 
-        graph.graph.addConnection (connection);
+        // the graph may never report it if the same connection was only taken apart by this drag
+        if (graph.graph.addConnection (connection))
+            connectionAdded (connection);
     }
 }
 
@@ -1046,6 +1163,43 @@ struct GraphDocumentComponent::TooltipBar final : public Component,
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (TooltipBar)
 };
 
+//==============================================================================
+/** Covers the status bar while a graph is being loaded in the background. */
+struct GraphDocumentComponent::LoadingBar final : public Component,
+                                                  private Timer
+{
+    explicit LoadingBar (PluginGraph& g)  : graph (g)
+    {
+        addAndMakeVisible (progressBar);
+        addAndMakeVisible (cancelButton);
+
+        cancelButton.onClick = [this] { graph.cancelLoading(); };
+
+        setVisible (false);
+        startTimer (100);
+    }
+
+    void resized() override
+    {
+        auto r = getLocalBounds();
+        cancelButton.setBounds (r.removeFromRight (80).reduced (2));
+        progressBar.setBounds (r.reduced (2));
+    }
+
+    void timerCallback() override
+    {
+        progress = graph.getLoadProgress();
+        setVisible (graph.isLoading());
+    }
+
+    PluginGraph& graph;
+    double progress = 0.0;
+    ProgressBar progressBar { progress };
+    TextButton cancelButton { "Cancel" };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (LoadingBar)
+};
+
 //==============================================================================
 class GraphDocumentComponent::TitleBarComponent final : public Component,
                                                         private Button::Listener
@@ -1233,7 +1387,18 @@ void GraphDocumentComponent::init()
 
     graphPanel.reset (new GraphEditorPanel (*graph));
     addAndMakeVisible (graphPanel.get());
-    graphPlayer.setProcessor (&graph->graph);
+
+    auto* props = getAppProperties().getUserSettings();
+
+    ParallelGraphRenderer::Options options;
+    options.numWorkers   = props->getIntValue ("parallelRenderingThreads", options.numWorkers);
+    options.affinityMask = (uint32) props->getIntValue ("parallelRenderingAffinityMask", 0);
+
+    graphRenderer = std::make_unique<ParallelGraphRenderer> (graph->graph, options);
+    graphRenderer->setParallelRenderingEnabled (props->getBoolValue ("parallelGraphRendering", true));
+    graphPlayer.setProcessor (graphRenderer.get());
+
+    setNodeProfiling (props->getBoolValue ("showNodeProfiling", false));
 
     keyState.addListener (&graphPlayer.getMidiMessageCollector());
 
@@ -1241,6 +1406,8 @@ void GraphDocumentComponent::init()
     addAndMakeVisible (keyboardComp.get());
     statusBar.reset (new TooltipBar());
     addAndMakeVisible (statusBar.get());
+    loadingBar.reset (new LoadingBar (*graph));
+    addChildComponent (loadingBar.get());
 
     graphPanel->updateComponents();
 
@@ -1296,6 +1463,7 @@ void GraphDocumentComponent::resized()
 
     keyboardComp->setBounds (r.removeFromBottom (keysHeight));
     statusBar->setBounds (r.removeFromBottom (statusHeight));
+    loadingBar->setBounds (statusBar->getBounds());
     graphPanel->setBounds (r);
 
     checkAvailableWidth();
@@ -1319,8 +1487,10 @@ void GraphDocumentComponent::releaseGraph()
 
     keyboardComp = nullptr;
     statusBar = nullptr;
+    loadingBar = nullptr;
 
     graphPlayer.setProcessor (nullptr);
+    graphRenderer = nullptr;
     graph = nullptr;
 }
 
@@ -1384,6 +1554,44 @@ void GraphDocumentComponent::setDoublePrecision (bool doublePrecision)
     graphPlayer.setDoublePrecisionProcessing (doublePrecision);
 }
 
+void GraphDocumentComponent::setParallelRendering (bool shouldRenderInParallel)
+{
+    if (graphRenderer != nullptr)
+        graphRenderer->setParallelRenderingEnabled (shouldRenderInParallel);
+}
+
+void GraphDocumentComponent::setNodeProfiling (bool shouldProfile)
+{
+    if (graphRenderer == nullptr)
+        return;
+
+    graphRenderer->setProfilingEnabled (shouldProfile);
+
+    if (graphPanel != nullptr)
+        graphPanel->setProfiler (shouldProfile ? &graphRenderer->getProfiler() : nullptr);
+}
+
+void GraphDocumentComponent::exportNodeProfile()
+{
+    if (graphRenderer == nullptr || graph == nullptr)
+        return;
+
+    profileChooser = std::make_unique<FileChooser> ("Export plug-in timings", File(), "*.csv");
+
+    const auto onChosen = [ref = SafePointer<GraphDocumentComponent> (this)] (const FileChooser& chooser)
+    {
+        const auto result = chooser.getResult();
+
+        if (ref == nullptr || ref->graphRenderer == nullptr || result == File())
+            return;
+
+        result.withFileExtension ("csv")
+              .replaceWithText (ref->graphRenderer->getProfiler().toCSV (ref->graph->graph));
+    };
+
+    profileChooser->launchAsync (FileBrowserComponent::saveMode | FileBrowserComponent::warnAboutOverwriting, onChosen);
+}
+
 bool GraphDocumentComponent::closeAnyOpenPluginWindows()
 {
     return graphPanel->graph.closeAnyOpenPluginWindows();
@@ -35,6 +35,7 @@
 #pragma once
 
 #include "../Plugins/PluginGraph.h"
+#include "../Plugins/ParallelGraphRenderer.h"
 
 class MainHostWindow;
 
@@ -44,6 +45,7 @@ class MainHostWindow;
 */
 class GraphEditorPanel final : public Component,
                                public ChangeListener,
+                               private PluginGraph::Listener,
                                private Timer
 {
 public:
@@ -63,8 +65,14 @@ public:
     void changeListenerCallback (ChangeBroadcaster*) override;
 
     //==============================================================================
+    /** Brings every node and connector up to date; changes to the graph's topology
+        arrive one at a time through the PluginGraph::Listener callbacks instead.
+    */
     void updateComponents();
 
+    // draws each node's timings from this profiler, or nothing if it's null
+    void setProfiler (NodeProfiler*);
+
     //==============================================================================
     void showPopupMenu (Point<int> position);
 
@@ -83,15 +91,28 @@ private:
     struct ConnectorComponent;
     struct PinComponent;
 
-    OwnedArray<PluginComponent> nodes;
-    OwnedArray<ConnectorComponent> connectors;
+    using Connection = AudioProcessorGraph::Connection;
+
+    std::unordered_map<uint32, std::unique_ptr<PluginComponent>> nodes;
+    std::unordered_map<Connection, std::unique_ptr<ConnectorComponent>, PluginGraph::ConnectionHash> connectors;
+    std::unordered_multimap<uint32, ConnectorComponent*> connectorsByNode;     // each connector is under both its ends
     std::unique_ptr<ConnectorComponent> draggingConnector;
     std::unique_ptr<PopupMenu> menu;
+    NodeProfiler* profiler = nullptr;
 
     PluginComponent* getComponentForPlugin (AudioProcessorGraph::NodeID) const;
-    ConnectorComponent* getComponentForConnection (const AudioProcessorGraph::Connection&) const;
     PinComponent* findPinAt (Point<float>) const;
 
+    std::unique_ptr<ConnectorComponent> releaseConnector (const Connection&);
+    void updateConnectorsOf (AudioProcessorGraph::NodeID);
+
+    void nodeAdded (AudioProcessorGraph::NodeID) override;
+    void nodeRemoved (AudioProcessorGraph::NodeID) override;
+    void nodeMoved (AudioProcessorGraph::NodeID) override;
+    void connectionAdded (const Connection&) override;
+    void connectionRemoved (const Connection&) override;
+    void pluginsChanged() override;
+
     //==============================================================================
     Point<int> originalTouchPos;
 
@@ -122,6 +143,9 @@ public:
     //==============================================================================
     void createNewPlugin (const PluginDescriptionAndPreference&, Point<int> position);
     void setDoublePrecision (bool doublePrecision);
+    void setParallelRendering (bool shouldRenderInParallel);
+    void setNodeProfiling (bool shouldProfile);
+    void exportNodeProfile();
     bool closeAnyOpenPluginWindows();
 
     //==============================================================================
@@ -149,13 +173,18 @@ private:
     AudioDeviceManager& deviceManager;
     KnownPluginList& pluginList;
 
+    std::unique_ptr<ParallelGraphRenderer> graphRenderer;
     AudioProcessorPlayer graphPlayer;
     MidiKeyboardState keyState;
     MidiOutput* midiOutput = nullptr;
+    std::unique_ptr<FileChooser> profileChooser;
 
     struct TooltipBar;
     std::unique_ptr<TooltipBar> statusBar;
 
+    struct LoadingBar;
+    std::unique_ptr<LoadingBar> loadingBar;
+
     class TitleBarComponent;
     std::unique_ptr<TitleBarComponent> titleBarComponent;
 
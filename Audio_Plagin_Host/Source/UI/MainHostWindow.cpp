@@ -35,8 +35,17 @@
 #include <JuceHeader.h>
 #include "MainHostWindow.h"
 #include "../Plugins/InternalPlugins.h"
+#include "../Plugins/PluginDescriptionCodec.h"
+#include "../Plugins/PluginScanCache.h"
 
 constexpr const char* scanModeKey = "pluginScanMode";
+constexpr const char* scanProcessesKey = "pluginScanProcesses";
+constexpr const char* scanTimeoutKey = "pluginScanTimeoutSeconds";
+
+static int getNumScanProcesses()
+{
+    return jmax (1, getAppProperties().getUserSettings()->getIntValue (scanProcessesKey, SystemStats::getNumCpus()));
+}
 
 //==============================================================================
 class Superprocess final : private ChildProcessCoordinator
@@ -51,13 +60,14 @@ public:
     {
         timeout,
         gotResult,
+        unreadableResult,
         connectionLost,
     };
 
     struct Response
     {
         State state;
-        std::unique_ptr<XmlElement> xml;
+        std::vector<PluginDescription> descriptions;
     };
 
     Response getResponse()
@@ -65,13 +75,15 @@ public:
         std::unique_lock<std::mutex> lock { mutex };
 
         if (! condvar.wait_for (lock, std::chrono::milliseconds { 50 }, [&] { return gotResult || connectionLost; }))
-            return { State::timeout, nullptr };
+            return { State::timeout, {} };
 
-        const auto state = connectionLost ? State::connectionLost : State::gotResult;
+        const auto state = connectionLost ? State::connectionLost
+                         : resultWasReadable ? State::gotResult
+                                             : State::unreadableResult;
         connectionLost = false;
         gotResult = false;
 
-        return { state, std::move (pluginDescription) };
+        return { state, std::exchange (pluginDescriptions, {}) };
     }
 
     using ChildProcessCoordinator::sendMessageToWorker;
@@ -80,7 +92,16 @@ private:
     void handleMessageFromWorker (const MemoryBlock& mb) override
     {
         const std::lock_guard<std::mutex> lock { mutex };
-        pluginDescription = parseXML (mb.toString());
+        pluginDescriptions.clear();
+
+        // a worker from another build can't be understood, and its answer mustn't be
+        // mistaken for a file that has no plug-ins in it
+        resultWasReadable = PluginDescriptionCodec::decode (mb, pluginDescriptions);
+        jassert (resultWasReadable);
+
+        if (! resultWasReadable)
+            pluginDescriptions.clear();
+
         gotResult = true;
         condvar.notify_one();
     }
@@ -95,14 +116,19 @@ private:
     std::mutex mutex;
     std::condition_variable condvar;
 
-    std::unique_ptr<XmlElement> pluginDescription;
+    std::vector<PluginDescription> pluginDescriptions;
     bool connectionLost = false;
     bool gotResult = false;
+    bool resultWasReadable = false;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (Superprocess)
 };
 
 //==============================================================================
+/*  Out of process, each scanning thread gets a Superprocess of its own, so files are
+    scanned in parallel and a plug-in that crashes or hangs only takes its own process
+    down. Superprocesses are kept between files and reused by whichever thread is next.
+*/
 class CustomPluginScanner final : public KnownPluginList::CustomScanner,
                                   private ChangeListener
 {
@@ -125,23 +151,33 @@ public:
                              OwnedArray<PluginDescription>& result,
                              const String& fileOrIdentifier) override
     {
+        if (cache.lookup (format.getName(), fileOrIdentifier, result))
+            return true;
+
         if (scanInProcess)
         {
-            superprocess = nullptr;
+            releaseIdleSuperprocesses();
             format.findAllTypesForFile (result, fileOrIdentifier);
+            cache.store (format.getName(), fileOrIdentifier, result);
             return true;
         }
 
         if (addPluginDescriptions (format.getName(), fileOrIdentifier, result))
+        {
+            // a scan that was cut short hasn't found everything
+            if (! shouldExit())
+                cache.store (format.getName(), fileOrIdentifier, result);
+
             return true;
+        }
 
-        superprocess = nullptr;
         return false;
     }
 
     void scanFinished() override
     {
-        superprocess = nullptr;
+        releaseIdleSuperprocesses();
+        cache.save();
     }
 
 private:
@@ -150,14 +186,14 @@ private:
 
         Returns true on success.
 
-        Failure indicates that the subprocess is unrecoverable and should be terminated.
+        Failure means the plug-in crashed or hung the subprocess, which has been terminated,
+        or that its answer couldn't be read. Either way nothing should be cached for the file.
     */
     bool addPluginDescriptions (const String& formatName,
                                 const String& fileOrIdentifier,
                                 OwnedArray<PluginDescription>& result)
     {
-        if (superprocess == nullptr)
-            superprocess = std::make_unique<Superprocess>();
+        auto superprocess = takeSuperprocess();
 
         MemoryBlock block;
         MemoryOutputStream stream { block, true };
@@ -167,35 +203,78 @@ private:
         if (! superprocess->sendMessageToWorker (block))
             return false;
 
+        const auto startTime = Time::getMillisecondCounter();
+
         for (;;)
         {
+            // the subprocess is still busy with this file, so it can't be reused
             if (shouldExit())
                 return true;
 
-            const auto response = superprocess->getResponse();
+            auto response = superprocess->getResponse();
 
             if (response.state == Superprocess::State::timeout)
+            {
+                // dropping the superprocess closes the connection, and the worker ends itself
+                // as soon as it notices, even if the plug-in has its message thread stuck
+                if (Time::getMillisecondCounter() - startTime > (uint32) timeoutMs.load())
+                    return false;
+
                 continue;
+            }
 
-            if (response.xml != nullptr)
-            {
-                for (const auto* item : response.xml->getChildIterator())
-                {
-                    auto desc = std::make_unique<PluginDescription>();
+            for (auto& desc : response.descriptions)
+                result.add (std::make_unique<PluginDescription> (std::move (desc)));
 
-                    if (desc->loadFromXml (*item))
-                        result.add (std::move (desc));
-                }
+            if (response.state != Superprocess::State::gotResult)
+                return false;
+
+            returnSuperprocess (std::move (superprocess));
+            return true;
+        }
+    }
+
+    std::unique_ptr<Superprocess> takeSuperprocess()
+    {
+        {
+            const std::lock_guard<std::mutex> lock { idleMutex };
+
+            if (! idleSuperprocesses.empty())
+            {
+                auto superprocess = std::move (idleSuperprocesses.back());
+                idleSuperprocesses.pop_back();
+                return superprocess;
             }
+        }
+
+        return std::make_unique<Superprocess>();
+    }
+
+    void returnSuperprocess (std::unique_ptr<Superprocess> superprocess)
+    {
+        const std::lock_guard<std::mutex> lock { idleMutex };
+        idleSuperprocesses.push_back (std::move (superprocess));
+    }
+
+    void releaseIdleSuperprocesses()
+    {
+        std::vector<std::unique_ptr<Superprocess>> toRelease;
 
-            return (response.state == Superprocess::State::gotResult);
+        {
+            const std::lock_guard<std::mutex> lock { idleMutex };
+            std::swap (toRelease, idleSuperprocesses);
         }
     }
 
     void handleChange()
     {
         if (auto* file = getAppProperties().getUserSettings())
+        {
             scanInProcess = (file->getIntValue (scanModeKey) == 0);
+
+            // a plug-in that takes longer than this to scan is treated as if it had crashed
+            timeoutMs = 1000 * jmax (1, file->getIntValue (scanTimeoutKey, 60));
+        }
     }
 
     void changeListenerCallback (ChangeBroadcaster*) override
@@ -203,9 +282,12 @@ private:
         handleChange();
     }
 
-    std::unique_ptr<Superprocess> superprocess;
+    std::mutex idleMutex;
+    std::vector<std::unique_ptr<Superprocess>> idleSuperprocesses;
+    PluginScanCache cache { getAppProperties().getUserSettings()->getFile().getSiblingFile ("PluginScanCache.xml") };
 
     std::atomic<bool> scanInProcess { true };
+    std::atomic<int> timeoutMs { 60000 };
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (CustomPluginScanner)
 };
@@ -238,8 +320,10 @@ public:
         validationModeBox.onChange = [this]
         {
             getAppProperties().getUserSettings()->setValue (scanModeKey, validationModeBox.getSelectedItemIndex());
+            updateNumberOfThreads();
         };
 
+        updateNumberOfThreads();
         handleResize();
     }
 
@@ -249,6 +333,13 @@ public:
     }
 
 private:
+    // in-process scans stay on the message thread, as not every format can be scanned anywhere else
+    void updateNumberOfThreads()
+    {
+        const auto outOfProcess = getAppProperties().getUserSettings()->getIntValue (scanModeKey) != 0;
+        setNumberOfThreadsForScanning (outOfProcess ? getNumScanProcesses() : 0);
+    }
+
     void handleResize()
     {
         PluginListComponent::resized();
@@ -561,6 +652,10 @@ PopupMenu MainHostWindow::getMenuForIndex (int topLevelMenuIndex, const String&
         menu.addSeparator();
         menu.addCommandItem (&getCommandManager(), CommandIDs::showAudioSettings);
         menu.addCommandItem (&getCommandManager(), CommandIDs::toggleDoublePrecision);
+        menu.addCommandItem (&getCommandManager(), CommandIDs::toggleParallelRendering);
+        menu.addCommandItem (&getCommandManager(), CommandIDs::toggleNodeProfiling);
+        menu.addCommandItem (&getCommandManager(), CommandIDs::exportNodeProfile);
+        menu.addCommandItem (&getCommandManager(), CommandIDs::toggleBinaryGraphFiles);
 
         if (autoScaleOptionAvailable)
             menu.addCommandItem (&getCommandManager(), CommandIDs::autoScalePluginWindows);
@@ -602,7 +697,7 @@ void MainHostWindow::menuItemSelected (int menuItemID, int /*topLevelMenuIndex*/
                         return;
 
                     if (r == FileBasedDocument::savedOk)
-                        parent->graphHolder->graph->loadFrom (recentFiles.getFile (menuItemID - 100), true);
+                        parent->graphHolder->graph->loadFromAsync (recentFiles.getFile (menuItemID - 100), true, [] (Result) {});
                 });
             }
         }
@@ -751,6 +846,10 @@ void MainHostWindow::getAllCommands (Array<CommandID>& commands)
                               CommandIDs::showPluginListEditor,
                               CommandIDs::showAudioSettings,
                               CommandIDs::toggleDoublePrecision,
+                              CommandIDs::toggleParallelRendering,
+                              CommandIDs::toggleNodeProfiling,
+                              CommandIDs::exportNodeProfile,
+                              CommandIDs::toggleBinaryGraphFiles,
                               CommandIDs::aboutBox,
                               CommandIDs::allWindowsForward,
                               CommandIDs::autoScalePluginWindows
@@ -803,6 +902,23 @@ void MainHostWindow::getCommandInfo (const CommandID commandID, ApplicationComma
         updatePrecisionMenuItem (result);
         break;
 
+    case CommandIDs::toggleParallelRendering:
+        updateParallelRenderingMenuItem (result);
+        break;
+
+    case CommandIDs::toggleNodeProfiling:
+        updateNodeProfilingMenuItem (result);
+        break;
+
+    case CommandIDs::exportNodeProfile:
+        result.setInfo ("Export Plug-in CPU Usage...", "Saves the timings of every plug-in as CSV", category, 0);
+        result.setActive (isNodeProfilingEnabled());
+        break;
+
+    case CommandIDs::toggleBinaryGraphFiles:
+        updateBinaryGraphFilesMenuItem (result);
+        break;
+
     case CommandIDs::aboutBox:
         result.setInfo ("About...", {}, category, 0);
         break;
@@ -893,6 +1009,52 @@ bool MainHostWindow::perform (const InvocationInfo& info)
         }
         break;
 
+    case CommandIDs::toggleParallelRendering:
+        if (auto* props = getAppProperties().getUserSettings())
+        {
+            auto newIsParallel = ! isParallelRenderingEnabled();
+            props->setValue ("parallelGraphRendering", var (newIsParallel));
+
+            ApplicationCommandInfo cmdInfo (info.commandID);
+            updateParallelRenderingMenuItem (cmdInfo);
+            menuItemsChanged();
+
+            if (graphHolder != nullptr)
+                graphHolder->setParallelRendering (newIsParallel);
+        }
+        break;
+
+    case CommandIDs::toggleNodeProfiling:
+        if (auto* props = getAppProperties().getUserSettings())
+        {
+            auto newIsProfiling = ! isNodeProfilingEnabled();
+            props->setValue ("showNodeProfiling", var (newIsProfiling));
+
+            ApplicationCommandInfo cmdInfo (info.commandID);
+            updateNodeProfilingMenuItem (cmdInfo);
+            menuItemsChanged();
+
+            if (graphHolder != nullptr)
+                graphHolder->setNodeProfiling (newIsProfiling);
+        }
+        break;
+
+    case CommandIDs::exportNodeProfile:
+        if (graphHolder != nullptr)
+            graphHolder->exportNodeProfile();
+        break;
+
+    case CommandIDs::toggleBinaryGraphFiles:
+        if (auto* props = getAppProperties().getUserSettings())
+        {
+            props->setValue ("saveBinaryGraphFiles", var (! isBinaryGraphFilesEnabled()));
+
+            ApplicationCommandInfo cmdInfo (info.commandID);
+            updateBinaryGraphFilesMenuItem (cmdInfo);
+            menuItemsChanged();
+        }
+        break;
+
     case CommandIDs::autoScalePluginWindows:
         if (auto* props = getAppProperties().getUserSettings())
         {
@@ -998,7 +1160,7 @@ void MainHostWindow::filesDropped (const StringArray& files, int x, int y)
                         return;
 
                     if (r == FileBasedDocument::savedOk)
-                        g->loadFrom (firstFile, true);
+                        g->loadFromAsync (firstFile, true, [] (Result) {});
                 });
             }
         }
@@ -1025,6 +1187,30 @@ bool MainHostWindow::isDoublePrecisionProcessingEnabled()
     return false;
 }
 
+bool MainHostWindow::isParallelRenderingEnabled()
+{
+    if (auto* props = getAppProperties().getUserSettings())
+        return props->getBoolValue ("parallelGraphRendering", true);
+
+    return false;
+}
+
+bool MainHostWindow::isNodeProfilingEnabled()
+{
+    if (auto* props = getAppProperties().getUserSettings())
+        return props->getBoolValue ("showNodeProfiling", false);
+
+    return false;
+}
+
+bool MainHostWindow::isBinaryGraphFilesEnabled()
+{
+    if (auto* props = getAppProperties().getUserSettings())
+        return props->getBoolValue ("saveBinaryGraphFiles", false);
+
+    return false;
+}
+
 bool MainHostWindow::isAutoScalePluginWindowsEnabled()
 {
     if (auto* props = getAppProperties().getUserSettings())
@@ -1039,6 +1225,24 @@ void MainHostWindow::updatePrecisionMenuItem (ApplicationCommandInfo& info)
     info.setTicked (isDoublePrecisionProcessingEnabled());
 }
 
+void MainHostWindow::updateParallelRenderingMenuItem (ApplicationCommandInfo& info)
+{
+    info.setInfo ("Render Independent Plug-ins in Parallel", {}, "General", 0);
+    info.setTicked (isParallelRenderingEnabled());
+}
+
+void MainHostWindow::updateNodeProfilingMenuItem (ApplicationCommandInfo& info)
+{
+    info.setInfo ("Show Plug-in CPU Usage", {}, "General", 0);
+    info.setTicked (isNodeProfilingEnabled());
+}
+
+void MainHostWindow::updateBinaryGraphFilesMenuItem (ApplicationCommandInfo& info)
+{
+    info.setInfo ("Save Graphs in Binary Format", "Stores plug-in states as raw blobs instead of base64 XML", "General", 0);
+    info.setTicked (isBinaryGraphFilesEnabled());
+}
+
 void MainHostWindow::updateAutoScaleMenuItem (ApplicationCommandInfo& info)
 {
     info.setInfo ("Auto-Scale Plug-in Windows", {}, "General", 0);
@@ -53,6 +53,10 @@ namespace CommandIDs
     static const int allWindowsForward      = 0x30400;
     static const int toggleDoublePrecision  = 0x30500;
     static const int autoScalePluginWindows = 0x30600;
+    static const int toggleParallelRendering = 0x30700;
+    static const int toggleNodeProfiling    = 0x30800;
+    static const int exportNodeProfile      = 0x30900;
+    static const int toggleBinaryGraphFiles = 0x30a00;
 }
 
 //==============================================================================
@@ -127,9 +131,15 @@ private:
     //==============================================================================
     static bool isDoublePrecisionProcessingEnabled();
     static bool isAutoScalePluginWindowsEnabled();
+    static bool isParallelRenderingEnabled();
+    static bool isNodeProfilingEnabled();
+    static bool isBinaryGraphFilesEnabled();
 
     static void updatePrecisionMenuItem (ApplicationCommandInfo& info);
     static void updateAutoScaleMenuItem (ApplicationCommandInfo& info);
+    static void updateParallelRenderingMenuItem (ApplicationCommandInfo& info);
+    static void updateNodeProfilingMenuItem (ApplicationCommandInfo& info);
+    static void updateBinaryGraphFilesMenuItem (ApplicationCommandInfo& info);
 
     void showAudioSettings();
 
@@ -9,6 +9,8 @@
 #pragma once
 
 #include "eq_plagin/PluginProcessor.h"
+#include "eq_plagin/ResponseCurveGLRenderer.h"
+#include "eq_plagin/SharedFFTCache.h"
 
 enum FFTOrder {
 
@@ -18,57 +20,124 @@ enum FFTOrder {
 };
 
 //=============================================================================
+enum class AnalyzerMode {
+  PerChannel,  // one spectrum per input channel
+  MidSide,     // channels 0/1 are analysed as (L+R)/2 and (L-R)/2
+};
+
+//=============================================================================
+/**
+    Produces one magnitude spectrum (in dB) per channel.
+
+    Two real channels are packed into a single complex FFT (x + jy) and
+    separated again using the conjugate symmetry of real spectra, so N
+    channels cost ceil(N/2) FFTs. Every frame is pushed to the fifo as one
+    block holding numChannels * fftSize/2 values, channel after channel.
+*/
 template <typename BlockType>
 struct FFTDataGenerator {
   void produceFFTDataForRendering(const juce::AudioBuffer<float> &audioData,
                                   const float negativeInfinity) {
+    using Complex = juce::dsp::Complex<float>;
+
     const auto fftSize = getFFTSize();
+    const int numBins = fftSize / 2;
+    const auto numInputChannels = juce::jmin(numChannels, audioData.getNumChannels());
 
-    fftData.assign(fftData.size(), 0);
-    auto *readIndex = audioData.getReadPointer(0);
-    std::copy(readIndex, readIndex + fftSize, fftData.begin());
+    jassert(audioData.getNumSamples() >= fftSize);
 
-    window->multiplyWithWindowingTable(fftData.data(), fftSize);
+    fftData.assign(fftData.size(), negativeInfinity);
 
-    forwardFFT->performFrequencyOnlyForwardTransform(fftData.data());
+    for (int first = 0; first < numInputChannels; first += 2) {
+      const int second = first + 1;
+      const bool hasSecond = second < numInputChannels;
 
-    int numBins = (int)fftSize / 2;
+      auto *re = scratch.getWritePointer(0);
+      auto *im = scratch.getWritePointer(1);
 
-    for (int i = 0; i < numBins; ++i) {
-      fftData[i] /= (float)numBins;
-    }
+      juce::FloatVectorOperations::copy(re, audioData.getReadPointer(first), fftSize);
+
+      if (hasSecond)
+        juce::FloatVectorOperations::copy(im, audioData.getReadPointer(second), fftSize);
+      else
+        juce::FloatVectorOperations::clear(im, fftSize);
+
+      if (mode == AnalyzerMode::MidSide && first == 0 && hasSecond) {
+        // re = (L + R) / 2, im = (L - R) / 2
+        juce::FloatVectorOperations::add(re, im, fftSize);
+        juce::FloatVectorOperations::multiply(im, -2.f, fftSize);
+        juce::FloatVectorOperations::add(im, re, fftSize);
+        juce::FloatVectorOperations::multiply(re, 0.5f, fftSize);
+        juce::FloatVectorOperations::multiply(im, 0.5f, fftSize);
+      }
 
-    for (int i = 0; i < numBins; ++i) {
-      fftData[i] = juce::Decibels::gainToDecibels(fftData[i], negativeInfinity);
+      window->multiplyWithWindowingTable(re, (size_t)fftSize);
+      window->multiplyWithWindowingTable(im, (size_t)fftSize);
+
+      for (int i = 0; i < fftSize; ++i) timeData[(size_t)i] = Complex(re[i], im[i]);
+
+      forwardFFT->perform(timeData.data(), frequencyData.data(), false);
+
+      auto *firstBins = fftData.data() + first * numBins;
+      auto *secondBins = fftData.data() + second * numBins;
+
+      for (int k = 0; k < numBins; ++k) {
+        // X[k] = (Z[k] + Z*[N-k]) / 2, Y[k] = (Z[k] - Z*[N-k]) / 2j
+        const auto z = frequencyData[(size_t)k];
+        const auto zMirror = std::conj(frequencyData[(size_t)((fftSize - k) & (fftSize - 1))]);
+
+        const auto firstMagnitude = std::abs(z + zMirror) * 0.5f / (float)numBins;
+        firstBins[k] = juce::Decibels::gainToDecibels(firstMagnitude, negativeInfinity);
+
+        if (hasSecond) {
+          const auto secondMagnitude = std::abs(z - zMirror) * 0.5f / (float)numBins;
+          secondBins[k] = juce::Decibels::gainToDecibels(secondMagnitude, negativeInfinity);
+        }
+      }
     }
 
     fftDataFifo.push(fftData);
   }
 
-  void changeOrder(FFTOrder newOrder) {
+  void changeOrder(FFTOrder newOrder, int newNumChannels = 1) {
     order = newOrder;
+    numChannels = juce::jmax(1, newNumChannels);
     auto fftSize = getFFTSize();
 
-    forwardFFT = std::make_unique<juce::dsp::FFT>(order);
-    window = std::make_unique<juce::dsp::WindowingFunction<float>>(
-        fftSize, juce::dsp::WindowingFunction<float>::hann);
+    // shared with every other analyzer in the process that uses the same order
+    forwardFFT = fftCache->getFFT(order);
+    window = fftCache->getWindow(fftSize, juce::dsp::WindowingFunction<float>::hann);
+
+    scratch.setSize(2, fftSize);
+    timeData.assign((size_t)fftSize, {});
+    frequencyData.assign((size_t)fftSize, {});
 
     fftData.clear();
-    fftData.resize(fftSize * 2, 0);
+    fftData.resize((size_t)(numChannels * fftSize / 2), 0);
 
     fftDataFifo.prepare(fftData.size());
   }
 
+  void setMode(AnalyzerMode newMode) { mode = newMode; }
+
   int getFFTSize() const { return 1 << order; }
+  int getNumBins() const { return getFFTSize() / 2; }
+  int getNumChannels() const { return numChannels; }
   int getNumAvailableFFTDataBlocks() const { return fftDataFifo.getNumAvailableForReading(); }
 
   bool getFFTData(BlockType &fftData) { return fftDataFifo.pull(fftData); }
 
  private:
   FFTOrder order;
+  int numChannels = 1;
+  AnalyzerMode mode = AnalyzerMode::PerChannel;
   BlockType fftData;
-  std::unique_ptr<juce::dsp::FFT> forwardFFT;
-  std::unique_ptr<juce::dsp::WindowingFunction<float>> window;
+  juce::SharedResourcePointer<SharedFFTCache> fftCache;
+  std::shared_ptr<const juce::dsp::FFT> forwardFFT;
+  std::shared_ptr<const juce::dsp::WindowingFunction<float>> window;
+
+  juce::AudioBuffer<float> scratch;
+  std::vector<juce::dsp::Complex<float>> timeData, frequencyData;
 
   Fifo<BlockType> fftDataFifo;
 };
@@ -76,7 +145,7 @@ struct FFTDataGenerator {
 
 template <typename PathType>
 struct AnalyzerPathGenerator {
-  void generatePath(const std::vector<float> &renderData, juce::Rectangle<float> fftBounds,
+  void generatePath(const float *renderData, juce::Rectangle<float> fftBounds,
                     int fftSize, float binWidth, float negativeInfinity) {
     auto top = fftBounds.getY();
     auto bottom = fftBounds.getHeight();
@@ -124,10 +193,24 @@ struct AnalyzerPathGenerator {
 };
 
 //=============================================================================
+struct RotarySliderWithLabels;
+
 struct LookAndFeel : public juce::LookAndFeel_V4 {
   virtual void drawRotarySlider(juce::Graphics &, int x, int y, int width, int height,
                                 float sliderPosProportional, float rotaryStartAngle,
                                 float rotaryEndAngle, juce::Slider &) override;
+
+  // the parts of drawRotarySlider that don't depend on the slider value
+  void drawRotarySliderBody(juce::Graphics &, juce::Rectangle<float> bounds);
+
+  // the parts that do: the pointer and the value text box
+  void drawRotarySliderPointer(juce::Graphics &, juce::Rectangle<float> bounds,
+                               float sliderPosProportional, float rotaryStartAngle,
+                               float rotaryEndAngle, const RotarySliderWithLabels &);
+
+ private:
+  juce::String lastValueText;
+  int lastValueTextWidth = 0;
 };
 
 struct RotarySliderWithLabels : juce::Slider {
@@ -148,6 +231,7 @@ struct RotarySliderWithLabels : juce::Slider {
 
   juce::Array<LabelPos> labels;
   void paint(juce::Graphics &g) override;
+  void resized() override;
 
   juce::Rectangle<int> getSliderBounds() const;
   int getTextHeight() const { return 14; }
@@ -157,27 +241,53 @@ struct RotarySliderWithLabels : juce::Slider {
   LookAndFeel lnf;
   juce::RangedAudioParameter *param;
   juce::String suffix;
+
+  // knob body and range labels, rendered once per size and scale factor
+  juce::Image staticLayer;
+  float staticLayerScale = 0.f;
+  void renderStaticLayer(float scale);
+
+  static float getStartAngle();
+  static float getEndAngle();
 };
 
 struct PathProducer {
-  PathProducer(SingleChannelSampleFifo<TestpluginAudioProcessor::BlockType> *scsf)
-      : leftChannelFifo(scsf) {
-    leftChannelFFTDataGenerator.changeOrder(FFTOrder::order2048);
-    monoBuffer.setSize(1, leftChannelFFTDataGenerator.getFFTSize());
-    }
-  void process(juce::Rectangle<float> fftBounds, double sampleRate);
-  juce::Path getPath() { return leftChannelFFTPath; }
+  using AnalyzerFifo = MultiChannelSampleFifo<TestpluginAudioProcessor::BlockType>;
+
+  PathProducer(AnalyzerFifo *mcsf) : analyzerFifo(mcsf) { prepare(1); }
+
+  // returns true if new analyzer frames arrived since the last call; the Paths are only
+  // built when generatePaths is set, the OpenGL renderer draws straight from getFFTData()
+  bool process(juce::Rectangle<float> fftBounds, double sampleRate, bool generatePaths);
+
+  int getNumChannels() const { return fftDataGenerator.getNumChannels(); }
+  juce::Path getPath(int channel) const { return paths[channel]; }
+
+  // latest spectrum of a channel in dB, getFFTSize() / 2 values (used by the OpenGL renderer)
+  const float *getFFTData(int channel) const {
+    return fftData.data() + channel * fftDataGenerator.getNumBins();
+  }
+  int getFFTSize() const { return fftDataGenerator.getFFTSize(); }
+
+  void setMode(AnalyzerMode newMode) { fftDataGenerator.setMode(newMode); }
+
+  // true while the latest spectrum sits entirely on the -48 dB floor
+  bool isSilent() const { return silent; }
 
  private:
-  SingleChannelSampleFifo<TestpluginAudioProcessor::BlockType> *leftChannelFifo;
+  AnalyzerFifo *analyzerFifo;
 
-  juce::AudioBuffer<float> monoBuffer;
+  juce::AudioBuffer<float> analysisBuffer;
 
-  FFTDataGenerator<std::vector<float>> leftChannelFFTDataGenerator;
+  FFTDataGenerator<std::vector<float>> fftDataGenerator;
 
-  AnalyzerPathGenerator<juce::Path> pathProducer;
+  juce::OwnedArray<AnalyzerPathGenerator<juce::Path>> pathGenerators;
 
-  juce::Path leftChannelFFTPath;
+  std::vector<juce::Path> paths;
+  std::vector<float> fftData;
+  bool silent = true;
+
+  void prepare(int numChannels);
 };
 
 struct ResponseCurveComponent : juce::Component,
@@ -195,18 +305,34 @@ struct ResponseCurveComponent : juce::Component,
   void paint(juce::Graphics &g) override;
   void resized() override;
 
+  void setOpenGLRenderingEnabled(bool shouldUseOpenGL);
+
+  static constexpr int activeRefreshRateHz = 60;
+  static constexpr int idleRefreshRateHz = 10;
+
  private:
   TestpluginAudioProcessor &audioProcessor;
   juce::Atomic<bool> parametersChanged{false};
 
+  bool analyzerWasSilent = false;
+  int idleTicks = 0;
+  void updateRefreshRate(bool isIdle);
+
   MonoChain monoChain;
   void updateChain();
 
+  std::vector<double> mags;
+  void updateResponseCurve();
+
   juce::Image background;
   juce::Rectangle<int> getRenderArea();
   juce::Rectangle<int> getAnalysisArea();
 
-  PathProducer leftPathProducer, rightPathProducer;
+  PathProducer pathProducer;
+
+  static juce::Colour getSpectrumColour(int channel);
+
+  ResponseCurveGLRenderer glRenderer{*this};
 };
 
 //==============================================================================
@@ -237,6 +363,10 @@ class TestpluginAudioProcessorEditor : public juce::AudioProcessorEditor {
 
   ResponseCurveComponent responseCurveComponent;
 
+  // created once the box has its items, so the attachment can select the current one
+  juce::ComboBox analyzerModeBox;
+  std::unique_ptr<APVTS::ComboBoxAttachment> analyzerModeAttachment;
+
   std::vector<juce::Component *> getComps();
 
   // std::unique_ptr<juce::Drawable> svgimg;
@@ -128,6 +128,68 @@ struct SingleChannelSampleFifo {
   }
 };
 //=============================================================================
+/**
+    Like SingleChannelSampleFifo, but collects blocks of every channel of the
+    incoming buffer so one analyzer can process all of them together.
+*/
+template <typename BlockType>
+struct MultiChannelSampleFifo {
+  MultiChannelSampleFifo() { prepared.set(false); }
+
+  void update(const BlockType &buffer) {
+    jassert(prepared.get());
+
+    const auto numChannels = juce::jmin(buffer.getNumChannels(), bufferToFill.getNumChannels());
+    const auto numSamples = buffer.getNumSamples();
+    const auto blockSize = bufferToFill.getNumSamples();
+
+    for (int start = 0; start < numSamples;) {
+      const auto numToCopy = juce::jmin(numSamples - start, blockSize - fifoIndex);
+
+      for (int ch = 0; ch < numChannels; ++ch)
+        bufferToFill.copyFrom(ch, fifoIndex, buffer, ch, start, numToCopy);
+
+      fifoIndex += numToCopy;
+      start += numToCopy;
+
+      // publish a block as soon as it is full rather than on the next call
+      if (fifoIndex == blockSize) {
+        auto ok = audioBufferFifo.push(bufferToFill);
+
+        juce::ignoreUnused(ok);
+
+        fifoIndex = 0;
+      }
+    }
+  }
+
+  void prepare(int numChannels, int bufferSize) {
+    prepared.set(false);
+    size.set(bufferSize);
+
+    bufferToFill.setSize(numChannels, bufferSize, false, true, true);
+    bufferToFill.clear();
+    audioBufferFifo.prepare(numChannels, bufferSize);
+    fifoIndex = 0;
+    prepared.set(true);
+  }
+
+  int getNumCompleteBuffersAvailable() const { return audioBufferFifo.getNumAvailableForReading(); }
+
+  bool isPrepared() const { return prepared.get(); }
+
+  int getSize() const { return size.get(); }
+
+  bool getAudioBuffer(BlockType &buf) { return audioBufferFifo.pull(buf); }
+
+ private:
+  int fifoIndex = 0;
+  Fifo<BlockType> audioBufferFifo;
+  BlockType bufferToFill;
+  juce::Atomic<bool> prepared = false;
+  juce::Atomic<int> size = 0;
+};
+//=============================================================================
 
 enum Slope {
   Slope_12,
@@ -243,8 +305,7 @@ class TestpluginAudioProcessor : public juce::AudioProcessor {
 
   using BlockType = juce::AudioBuffer<float>;
 
-  SingleChannelSampleFifo<BlockType> leftChannelFifo{Channel::Left};
-  SingleChannelSampleFifo<BlockType> rightChannelFifo{Channel::Right};
+  MultiChannelSampleFifo<BlockType> analyzerFifo;
 
   //======================My_user_code_end_here================================
 
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <juce_gui_basics/juce_gui_basics.h>
+#include <juce_opengl/juce_opengl.h>
+
+#include <array>
+#include <vector>
+
+//=============================================================================
+/**
+    Optional OpenGL back-end for ResponseCurveComponent.
+
+    The response curve and the analyzer spectra are uploaded as triangle
+    strips of (normalised x, normalised value) pairs, widened around each
+    curve so line widths don't depend on glLineWidth, and mapped into the
+    analysis area by a shader; the cached grid image stays on the GPU as a
+    texture until it changes. If the context turns out to be a software
+    rasteriser (Mesa llvmpipe/softpipe, SwiftShader...) or the shader does not
+    compile, the renderer detaches itself and the owner paints in software.
+*/
+struct ResponseCurveGLRenderer : juce::OpenGLRenderer {
+  static constexpr int maxNumSpectra = 8;
+
+  explicit ResponseCurveGLRenderer(juce::Component &owner);
+  ~ResponseCurveGLRenderer() override;
+
+  void attach();
+  void detach();
+  bool isAttached() const { return context.isAttached(); }
+
+  void setBackground(const juce::Image &image, juce::Rectangle<int> analysisArea);
+
+  void setResponseCurve(const std::vector<double> &magsInDecibels, double minDb, double maxDb);
+
+  void setNumSpectra(int numSpectra);
+
+  void setSpectrum(int spectrum, const float *fftDataInDecibels, int fftSize, float binWidth,
+                   float negativeInfinity, juce::Colour colour);
+
+  void newOpenGLContextCreated() override;
+  void renderOpenGL() override;
+  void openGLContextClosing() override;
+
+  static bool isSoftwareRasteriser(const juce::String &rendererName);
+
+ private:
+  juce::Component &owner;
+  juce::Component::SafePointer<juce::Component> safeOwner;
+  juce::OpenGLContext context;
+
+  std::unique_ptr<juce::OpenGLShaderProgram> shader;
+  std::unique_ptr<juce::OpenGLShaderProgram::Uniform> areaUniform, colourUniform;
+  juce::GLint positionAttribute = -1;
+  // slot 0 holds the response curve, the spectra follow
+  static constexpr int responseCurve = 0;
+  static constexpr int numCurves = maxNumSpectra + 1;
+
+  std::array<juce::GLuint, numCurves> vertexBuffers{};
+  std::array<bool, numCurves> needsUpload{};
+  std::array<std::vector<float>, numCurves> strips;
+  juce::Rectangle<int> stripArea;
+  float stripScale = 0;
+
+  juce::OpenGLTexture backgroundTexture;
+
+  // written on the message thread, consumed on the GL thread
+  juce::SpinLock lock;
+  std::array<std::vector<float>, numCurves> pendingVertices, vertices;
+  std::array<juce::Colour, numCurves> colours;
+  int numSpectra = 0;
+  juce::Image background;
+  bool backgroundChanged = false;
+  juce::Rectangle<int> analysisArea;
+
+  std::vector<float> binPositions;
+  int binPositionsFFTSize = 0;
+  float binPositionsBinWidth = 0;
+
+  void fallBackToSoftware();
+  void drawCurve(int curve, juce::Colour colour, float lineWidth, juce::Point<float> areaSize);
+  void buildStrip(int curve, float lineWidth, juce::Point<float> areaSize);
+
+  JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ResponseCurveGLRenderer)
+};
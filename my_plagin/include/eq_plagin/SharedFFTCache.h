@@ -0,0 +1,34 @@
+#pragma once
+
+#include <juce_dsp/juce_dsp.h>
+
+#include <map>
+#include <memory>
+#include <utility>
+
+//=============================================================================
+/**
+    Process-wide cache of FFT engines and window tables.
+
+    Every analyzer of every plugin instance in the process asks this cache for
+    its FFT and window instead of building its own, so identical twiddle and
+    window tables exist only once. Entries are handed out as shared_ptrs and
+    are freed when the last user lets go; the cache itself lives as long as
+    any SharedResourcePointer to it does.
+
+    Both juce::dsp::FFT::perform and WindowingFunction::multiplyWithWindowingTable
+    are const, so the shared objects are only ever read.
+*/
+struct SharedFFTCache {
+  using FFT = juce::dsp::FFT;
+  using Window = juce::dsp::WindowingFunction<float>;
+  using WindowType = Window::WindowingMethod;
+
+  std::shared_ptr<const FFT> getFFT(int order);
+  std::shared_ptr<const Window> getWindow(int size, WindowType type);
+
+ private:
+  juce::CriticalSection lock;
+  std::map<int, std::weak_ptr<const FFT>> ffts;
+  std::map<std::pair<int, WindowType>, std::weak_ptr<const Window>> windows;
+};
@@ -18,54 +18,110 @@ void LookAndFeel::drawRotarySlider(juce::Graphics &g, int x, int y, int width, i
 
   auto bounds = Rectangle<float>(x, y, width, height);
 
+  drawRotarySliderBody(g, bounds);
+
+  if (auto *rswl = dynamic_cast<RotarySliderWithLabels *>(&slider))
+    drawRotarySliderPointer(g, bounds, sliderPosProportional, rotaryStartAngle, rotaryEndAngle,
+                            *rswl);
+}
+
+void LookAndFeel::drawRotarySliderBody(juce::Graphics &g, juce::Rectangle<float> bounds) {
+  using namespace juce;
+
   g.setColour(Colour(97u, 18u, 167u));
   g.fillEllipse(bounds);
 
   g.setColour(Colour(255u, 154u, 1u));
   g.drawEllipse(bounds, 1.f);
+}
 
-  if (auto *rswl = dynamic_cast<RotarySliderWithLabels *>(&slider)) {
-    auto center = bounds.getCentre();
-
-    Path p;
+void LookAndFeel::drawRotarySliderPointer(juce::Graphics &g, juce::Rectangle<float> bounds,
+                                          float sliderPosProportional, float rotaryStartAngle,
+                                          float rotaryEndAngle,
+                                          const RotarySliderWithLabels &rswl) {
+  using namespace juce;
 
-    Rectangle<float> r;
-    r.setLeft(center.getX() - 2);
-    r.setRight(center.getX() + 2);
-    r.setTop(bounds.getY());
-    r.setBottom(center.getY() - rswl->getTextHeight() * 1.5);
+  auto center = bounds.getCentre();
 
-    p.addRoundedRectangle(r, 2.f);
-    jassert(rotaryStartAngle < rotaryEndAngle);
+  Path p;
 
-    auto sliderAngRad = jmap(sliderPosProportional, 0.f, 1.f, rotaryStartAngle, rotaryEndAngle);
+  Rectangle<float> r;
+  r.setLeft(center.getX() - 2);
+  r.setRight(center.getX() + 2);
+  r.setTop(bounds.getY());
+  r.setBottom(center.getY() - rswl.getTextHeight() * 1.5);
 
-    p.applyTransform(AffineTransform().rotated(sliderAngRad, center.getX(), center.getY()));
+  p.addRoundedRectangle(r, 2.f);
+  jassert(rotaryStartAngle < rotaryEndAngle);
 
-    g.fillPath(p);
+  auto sliderAngRad = jmap(sliderPosProportional, 0.f, 1.f, rotaryStartAngle, rotaryEndAngle);
 
-    g.setFont(rswl->getTextHeight());
-    auto text = rswl->getDisplayString();
-    auto strWidth = g.getCurrentFont().getStringWidth(text);
+  p.applyTransform(AffineTransform().rotated(sliderAngRad, center.getX(), center.getY()));
 
-    r.setSize(strWidth + 4, rswl->getTextHeight() + 2);
-    r.setCentre(bounds.getCentre());
+  g.setColour(Colour(255u, 154u, 1u));
+  g.fillPath(p);
 
-    g.setColour(Colours::black);
-    g.fillRect(r);
+  g.setFont(rswl.getTextHeight());
+  auto text = rswl.getDisplayString();
 
-    g.setColour(Colours::white);
-    g.drawFittedText(text, r.toNearestInt(), juce::Justification::centred, 1);
+  // the text only changes when the displayed value does, so don't re-measure it every paint
+  if (text != lastValueText) {
+    lastValueText = text;
+    lastValueTextWidth = g.getCurrentFont().getStringWidth(text);
   }
+
+  r.setSize(lastValueTextWidth + 4, rswl.getTextHeight() + 2);
+  r.setCentre(bounds.getCentre());
+
+  g.setColour(Colours::black);
+  g.fillRect(r);
+
+  g.setColour(Colours::white);
+  g.drawFittedText(text, r.toNearestInt(), juce::Justification::centred, 1);
+}
+
+float RotarySliderWithLabels::getStartAngle() {
+  return juce::degreesToRadians(180.f + 45.f);
+}
+
+float RotarySliderWithLabels::getEndAngle() {
+  return juce::degreesToRadians(180.f - 45.f) + juce::MathConstants<float>::twoPi;
 }
 
 void RotarySliderWithLabels::paint(juce::Graphics &g) {
   using namespace juce;
 
-  auto startAng = degreesToRadians(180.f + 45.f);
-  auto endAng = degreesToRadians(180.f - 45.f) + MathConstants<float>::twoPi;
+  auto scale = g.getInternalContext().getPhysicalPixelScaleFactor();
+
+  if (!staticLayer.isValid() || scale != staticLayerScale) renderStaticLayer(scale);
+
+  g.drawImage(staticLayer, getLocalBounds().toFloat());
 
   auto range = getRange();
+  auto sliderBounds = getSliderBounds();
+
+  lnf.drawRotarySliderPointer(g, sliderBounds.toFloat(),
+                              jmap(getValue(), range.getStart(), range.getEnd(), 0.0, 1.0),
+                              getStartAngle(), getEndAngle(), *this);
+}
+
+void RotarySliderWithLabels::resized() {
+  juce::Slider::resized();
+  staticLayer = {};
+}
+
+void RotarySliderWithLabels::renderStaticLayer(float scale) {
+  using namespace juce;
+
+  staticLayerScale = scale;
+  staticLayer = Image(Image::ARGB, jmax(1, roundToInt(getWidth() * scale)),
+                      jmax(1, roundToInt(getHeight() * scale)), true);
+
+  Graphics g(staticLayer);
+  g.addTransform(AffineTransform::scale(scale));
+
+  auto startAng = getStartAngle();
+  auto endAng = getEndAngle();
 
   auto sliderBounds = getSliderBounds();
 
@@ -74,10 +130,7 @@ void RotarySliderWithLabels::paint(juce::Graphics &g) {
   // g.setColour(Colours::yellow);
   // g.drawRect(sliderBounds);
 
-  getLookAndFeel().drawRotarySlider(g, sliderBounds.getX(), sliderBounds.getY(),
-                                    sliderBounds.getWidth(), sliderBounds.getHeight(),
-                                    jmap(getValue(), range.getStart(), range.getEnd(), 0.0, 1.0),
-                                    startAng, endAng, *this);
+  lnf.drawRotarySliderBody(g, sliderBounds.toFloat());
 
   auto center = sliderBounds.toFloat().getCentre();
   auto radius = sliderBounds.getWidth() * 0.5f;
@@ -157,8 +210,7 @@ juce::String RotarySliderWithLabels::getDisplayString() const {
 
 ResponseCurveComponent::ResponseCurveComponent(TestpluginAudioProcessor &p)
     : audioProcessor(p),
-      leftPathProducer(&audioProcessor.leftChannelFifo),
-      rightPathProducer(&audioProcessor.rightChannelFifo) {
+      pathProducer(&audioProcessor.analyzerFifo) {
   const auto &params = audioProcessor.getParameters();
   for (auto param : params) {
     param->addListener(this);
@@ -166,7 +218,7 @@ ResponseCurveComponent::ResponseCurveComponent(TestpluginAudioProcessor &p)
 
   updateChain();
 
-  startTimerHz(60);
+  startTimerHz(activeRefreshRateHz);
 }
 
 ResponseCurveComponent::~ResponseCurveComponent() {
@@ -179,57 +231,143 @@ ResponseCurveComponent::~ResponseCurveComponent() {
 void ResponseCurveComponent::parameterValueChanged(int parameterIndex, float newValue) {
   parametersChanged.set(true);
 }
-void PathProducer::process(juce::Rectangle<float> fftBounds, double sampleRate) {
+void PathProducer::prepare(int numChannels) {
+  fftDataGenerator.changeOrder(FFTOrder::order2048, numChannels);
+  analysisBuffer.setSize(numChannels, fftDataGenerator.getFFTSize());
+  analysisBuffer.clear();
+
+  pathGenerators.clear();
+  for (int ch = 0; ch < numChannels; ++ch)
+    pathGenerators.add(new AnalyzerPathGenerator<juce::Path>());
+
+  paths.assign((size_t)numChannels, {});
+  fftData.assign((size_t)(numChannels * fftDataGenerator.getNumBins()), -48.f);
+  silent = true;
+}
+
+bool PathProducer::process(juce::Rectangle<float> fftBounds, double sampleRate,
+                           bool generatePaths) {
   juce::AudioBuffer<float> tempIncomingBuffer;
 
-  while (leftChannelFifo->getNumCompleteBuffersAvailable() > 0) {
-    if (leftChannelFifo->getAudioBuffer(tempIncomingBuffer)) {
+  while (analyzerFifo->getNumCompleteBuffersAvailable() > 0) {
+    if (analyzerFifo->getAudioBuffer(tempIncomingBuffer)) {
+      // the bus layout decides how many channels get analysed
+      if (tempIncomingBuffer.getNumChannels() != getNumChannels())
+        prepare(juce::jmax(1, tempIncomingBuffer.getNumChannels()));
+
       auto size = tempIncomingBuffer.getNumSamples();
 
-      juce::FloatVectorOperations::copy(monoBuffer.getWritePointer(0, 0),
-                                        monoBuffer.getReadPointer(0, size),
-                                        monoBuffer.getNumSamples() - size);
+      for (int ch = 0; ch < analysisBuffer.getNumChannels(); ++ch) {
+        juce::FloatVectorOperations::copy(analysisBuffer.getWritePointer(ch, 0),
+                                          analysisBuffer.getReadPointer(ch, size),
+                                          analysisBuffer.getNumSamples() - size);
 
-      juce::FloatVectorOperations::copy(
-          monoBuffer.getWritePointer(0, monoBuffer.getNumSamples() - size),
-          tempIncomingBuffer.getReadPointer(0, 0), size);
+        juce::FloatVectorOperations::copy(
+            analysisBuffer.getWritePointer(ch, analysisBuffer.getNumSamples() - size),
+            tempIncomingBuffer.getReadPointer(ch, 0), size);
+      }
 
-      leftChannelFFTDataGenerator.produceFFTDataForRendering(monoBuffer, -48.f);
+      fftDataGenerator.produceFFTDataForRendering(analysisBuffer, -48.f);
     }
   }
 
-  const auto fftSize = leftChannelFFTDataGenerator.getFFTSize();
+  const auto fftSize = fftDataGenerator.getFFTSize();
+  const auto numBins = fftDataGenerator.getNumBins();
 
   const auto binWidth = sampleRate / (float)fftSize;
 
-  while (leftChannelFFTDataGenerator.getNumAvailableFFTDataBlocks() > 0) {
-    std::vector<float> fftData;
-    if (leftChannelFFTDataGenerator.getFFTData(fftData)) {
-      pathProducer.generatePath(fftData, fftBounds, fftSize, binWidth, -48.f);
+  bool hasNewFrames = false;
+
+  while (fftDataGenerator.getNumAvailableFFTDataBlocks() > 0) {
+    if (fftDataGenerator.getFFTData(fftData)) {
+      if (generatePaths)
+        for (int ch = 0; ch < getNumChannels(); ++ch)
+          pathGenerators[ch]->generatePath(fftData.data() + ch * numBins, fftBounds, fftSize,
+                                           binWidth, -48.f);
+      hasNewFrames = true;
     }
   }
 
-  while (pathProducer.getNumPathsAvailable()) {
-    pathProducer.getPath(leftChannelFFTPath);
+  for (int ch = 0; ch < getNumChannels(); ++ch) {
+    while (pathGenerators[ch]->getNumPathsAvailable()) {
+      pathGenerators[ch]->getPath(paths[(size_t)ch]);
+    }
+  }
+
+  if (hasNewFrames) {
+    auto peak = juce::FloatVectorOperations::findMaximum(fftData.data(), (int)fftData.size());
+    silent = peak <= -48.f;
   }
+
+  return hasNewFrames;
 }
 void ResponseCurveComponent::timerCallback() {
   auto fftBounds = getAnalysisArea().toFloat();
   auto sampleRate = audioProcessor.getSampleRate();
 
-  leftPathProducer.process(fftBounds, sampleRate);
-  rightPathProducer.process(fftBounds, sampleRate);
+  const auto analyzerMode = audioProcessor.apvts.getRawParameterValue("Analyzer Mode")->load();
+  pathProducer.setMode(analyzerMode > 0.5f ? AnalyzerMode::MidSide : AnalyzerMode::PerChannel);
+
+  const bool hasNewFrames =
+      pathProducer.process(fftBounds, sampleRate, !glRenderer.isAttached());
+  const bool isSilent = pathProducer.isSilent();
+
+  // a silent analyzer keeps producing the same flat line, only the first one needs painting
+  bool needsRepaint = hasNewFrames && !(isSilent && analyzerWasSilent);
 
-  if (parametersChanged.compareAndSetBool(false, true)) {
+  if (hasNewFrames) analyzerWasSilent = isSilent;
+
+  if (needsRepaint && glRenderer.isAttached()) {
+    const auto fftSize = pathProducer.getFFTSize();
+    const auto binWidth = float(sampleRate / (double)fftSize);
+    const auto numSpectra = juce::jmin(pathProducer.getNumChannels(),
+                                       (int)ResponseCurveGLRenderer::maxNumSpectra);
+
+    glRenderer.setNumSpectra(numSpectra);
+
+    for (int ch = 0; ch < numSpectra; ++ch)
+      glRenderer.setSpectrum(ch, pathProducer.getFFTData(ch), fftSize, binWidth, -48.f,
+                             getSpectrumColour(ch));
+  }
+
+  const bool paramsChanged = parametersChanged.compareAndSetBool(false, true);
+
+  if (paramsChanged) {
     // DBG("parameters changed");
     //  update the monoichaon
 
     updateChain();
+    updateResponseCurve();
 
-    // signal a repeint
-    // repaint();
+    needsRepaint = true;
   }
 
+  // the grid lives in the cached background, only the curves need repainting
+  if (needsRepaint) repaint(getAnalysisArea());
+
+  updateRefreshRate(!paramsChanged && (!hasNewFrames || isSilent));
+}
+
+void ResponseCurveComponent::updateRefreshRate(bool isIdle) {
+  // wait a few ticks before slowing down so short pauses between notes don't toggle the rate
+  constexpr int idleTicksBeforeSlowingDown = activeRefreshRateHz / 2;
+
+  idleTicks = isIdle ? juce::jmin(idleTicks + 1, idleTicksBeforeSlowingDown) : 0;
+
+  const auto rate =
+      idleTicks >= idleTicksBeforeSlowingDown ? idleRefreshRateHz : activeRefreshRateHz;
+
+  if (getTimerInterval() != 1000 / rate) startTimerHz(rate);
+}
+
+void ResponseCurveComponent::setOpenGLRenderingEnabled(bool shouldUseOpenGL) {
+  if (shouldUseOpenGL)
+    glRenderer.attach();
+  else
+    glRenderer.detach();
+
+  glRenderer.setBackground(background, getAnalysisArea());
+  updateResponseCurve();
   repaint();
 }
 
@@ -247,19 +385,9 @@ void ResponseCurveComponent::updateChain() {
                   chainSettings.highCutSlope);
 }
 
-void ResponseCurveComponent::paint(juce::Graphics &g) {
-  // (Our component is opaque, so we must completely fill the background with a
-  // solid colour)
-
-  // svgimg->drawWithin(g, getLocalBounds().toFloat(), juce::Justification::centred,
-  // 1);
-
+void ResponseCurveComponent::updateResponseCurve() {
   using namespace juce;
 
-  g.fillAll(Colours::black);
-
-  g.drawImage(background, getLocalBounds().toFloat());
-
   auto responseArea = getAnalysisArea();
 
   auto w = responseArea.getWidth();
@@ -270,9 +398,7 @@ void ResponseCurveComponent::paint(juce::Graphics &g) {
 
   auto sampleRate = audioProcessor.getSampleRate();
 
-  std::vector<double> mags;
-
-  mags.resize(w);
+  mags.resize(juce::jmax(0, w));
   for (int i = 0; i < w; ++i) {
     double mag = 1.f;
     auto freq = mapToLog10(double(i) / double(w), 20.0, 20000.0);
@@ -307,6 +433,28 @@ void ResponseCurveComponent::paint(juce::Graphics &g) {
     mags[i] = Decibels::gainToDecibels(mag);
   }
 
+  if (glRenderer.isAttached()) glRenderer.setResponseCurve(mags, -24.0, 24.0);
+}
+
+void ResponseCurveComponent::paint(juce::Graphics &g) {
+  // (Our component is opaque, so we must completely fill the background with a
+  // solid colour)
+
+  // svgimg->drawWithin(g, getLocalBounds().toFloat(), juce::Justification::centred,
+  // 1);
+
+  // while the OpenGL renderer is attached this is only used as a fallback
+  using namespace juce;
+
+  g.fillAll(Colours::black);
+
+  g.drawImage(background, getLocalBounds().toFloat());
+
+  auto responseArea = getAnalysisArea();
+
+  // the timer only invalidates the analysis area, so nothing may be drawn outside of it
+  g.reduceClipRegion(responseArea);
+
   Path responseCurve;
 
   const double outputMin = responseArea.getBottom();
@@ -316,34 +464,39 @@ void ResponseCurveComponent::paint(juce::Graphics &g) {
     return jmap(input, -24.0, 24.0, outputMin, outputMax);
   };
 
+  // Paint one FFT path per analysed channel
+  for (int ch = 0; ch < pathProducer.getNumChannels(); ++ch) {
+    auto channelFFTPath = pathProducer.getPath(ch);
+    channelFFTPath.applyTransform(
+        AffineTransform().translation(responseArea.getX(), responseArea.getY()));
+    g.setColour(getSpectrumColour(ch));
+    g.strokePath(channelFFTPath, PathStrokeType(1.f));
+  }
+
+  if (mags.empty()) return;
+
   responseCurve.startNewSubPath(responseArea.getX(), map(mags.front()));
 
   for (size_t i = 1; i < mags.size(); ++i) {
     responseCurve.lineTo(responseArea.getX() + i, map(mags[i]));
   }
 
-  // Paint the left FFT chanel
-  auto leftChannelFFTPath = leftPathProducer.getPath();
-  leftChannelFFTPath.applyTransform(
-      AffineTransform().translation(responseArea.getX(), responseArea.getY()));
-  g.setColour(Colours::skyblue);
-  g.strokePath(leftChannelFFTPath, PathStrokeType(1.f));
-
-  // Paint the right  FFT chanel
-  auto rightChannelFFTPath = rightPathProducer.getPath();
-  rightChannelFFTPath.applyTransform(
-      AffineTransform().translation(responseArea.getX(), responseArea.getY()));
-  g.setColour(Colours::lightyellow);
-  g.strokePath(rightChannelFFTPath, PathStrokeType(1.f));
-
-  g.setColour(Colours::orange);
-  g.drawRoundedRectangle(getRenderArea().toFloat(), 4.f, 1.f);
-
   g.setColour(Colours::white);
 
   g.strokePath(responseCurve, PathStrokeType(2.f));
 }
 
+juce::Colour ResponseCurveComponent::getSpectrumColour(int channel) {
+  // channel 0 (Channel::Right) and 1 (Channel::Left) keep their original colours
+  static const juce::Colour colours[] = {
+      juce::Colours::lightyellow, juce::Colours::skyblue, juce::Colours::lightgreen,
+      juce::Colours::salmon,      juce::Colours::violet,  juce::Colours::aquamarine,
+      juce::Colours::pink,        juce::Colours::wheat,
+  };
+
+  return colours[channel % juce::numElementsInArray(colours)];
+}
+
 void ResponseCurveComponent::resized() {
   using namespace juce;
   background = Image(Image::PixelFormat::RGB, getWidth(), getHeight(), true);
@@ -438,6 +591,12 @@ void ResponseCurveComponent::resized() {
 
     g.drawFittedText(str, r, juce::Justification::centred, 1);
   }
+
+  g.setColour(Colours::orange);
+  g.drawRoundedRectangle(getRenderArea().toFloat(), 4.f, 1.f);
+
+  glRenderer.setBackground(background, getAnalysisArea());
+  updateResponseCurve();
 };
 
 juce::Rectangle<int> ResponseCurveComponent::getRenderArea() {
@@ -503,10 +662,22 @@ TestpluginAudioProcessorEditor::TestpluginAudioProcessorEditor(TestpluginAudioPr
   highCutSlopeSlider.labels.add({0.f, "12"});
   highCutSlopeSlider.labels.add({1.f, "48"});
 
+  auto *analyzerMode = audioProcessor.apvts.getParameter("Analyzer Mode");
+
+  if (auto *choice = dynamic_cast<juce::AudioParameterChoice *>(analyzerMode))
+    analyzerModeBox.addItemList(choice->choices, 1);
+
+  analyzerModeAttachment = std::make_unique<APVTS::ComboBoxAttachment>(
+      audioProcessor.apvts, "Analyzer Mode", analyzerModeBox);
+
   for (auto comp : getComps()) {
     addAndMakeVisible(comp);
   }
 
+#if EQ_PLAGIN_USE_OPENGL
+  responseCurveComponent.setOpenGLRenderingEnabled(true);
+#endif
+
   setSize(600, 500);
   // load Image from BinaryData
   // svgimg = juce::Drawable::createFromImageData(BinaryData::jucelogo_svg,
@@ -541,6 +712,8 @@ void TestpluginAudioProcessorEditor::resized() {
 
   responseCurveComponent.setBounds(responseArea);
 
+  analyzerModeBox.setBounds(bounds.removeFromTop(24).removeFromRight(120).reduced(2));
+
   bounds.removeFromTop(5);
 
   auto lowCutArea = bounds.removeFromLeft(bounds.getWidth() * 0.33);
@@ -558,5 +731,6 @@ void TestpluginAudioProcessorEditor::resized() {
 
 std::vector<juce::Component *> TestpluginAudioProcessorEditor::getComps() {
   return {&peakFreqSlider,    &peakGainSlider,    &peakQualitySlider,  &lowCutFreqSlider,
-          &highCutFreqSlider, &lowCutSlopeSlider, &highCutSlopeSlider, &responseCurveComponent};
+          &highCutFreqSlider, &lowCutSlopeSlider, &highCutSlopeSlider, &responseCurveComponent,
+          &analyzerModeBox};
 }
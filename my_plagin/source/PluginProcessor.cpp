@@ -88,8 +88,7 @@ void TestpluginAudioProcessor::prepareToPlay(double sampleRate, int samplesPerBl
 
   updateFilters();
 
-  leftChannelFifo.prepare(samplesPerBlock);
-  rightChannelFifo.prepare(samplesPerBlock);
+  analyzerFifo.prepare(getTotalNumInputChannels(), samplesPerBlock);
 
   osc.initialise([](float x) { return std::sin(x); });
 
@@ -168,8 +167,7 @@ void TestpluginAudioProcessor::processBlock(juce::AudioBuffer<float> &buffer,
   leftChain.process(leftContext);
   rightChain.process(rightContext);
 
-  leftChannelFifo.update(buffer);
-  rightChannelFifo.update(buffer);
+  analyzerFifo.update(buffer);
 
   for (int channel = 0; channel < totalNumInputChannels; ++channel) {
     auto *channelData = buffer.getWritePointer(channel);
@@ -304,6 +302,12 @@ TestpluginAudioProcessor::createParameterLayout() {
   layout.add(std::make_unique<juce::AudioParameterChoice>("HighCut Slope", "HighCut Slope",
                                                           stringArray, 0));
 
+  // only read by the editor's analyzer, the audio path is the same in both modes, so it is
+  // kept with the plug-in's state but not offered to the host for automation
+  layout.add(std::make_unique<juce::AudioParameterChoice>(
+      "Analyzer Mode", "Analyzer Mode", juce::StringArray{"Per Channel", "Mid/Side"}, 0,
+      juce::AudioParameterChoiceAttributes().withAutomatable(false)));
+
   return layout;
 }
 
@@ -0,0 +1,315 @@
+#include "eq_plagin/ResponseCurveGLRenderer.h"
+
+#include <cmath>
+#include <utility>
+
+namespace {
+const char *vertexShaderSource = R"(
+attribute vec2 position;
+uniform vec4 area;
+
+void main()
+{
+    gl_Position = vec4 (mix (area.x, area.z, position.x), mix (area.y, area.w, position.y), 0.0, 1.0);
+}
+)";
+
+const char *fragmentShaderSource =
+    "uniform " JUCE_MEDIUMP " vec4 colour;\n"
+    "\n"
+    "void main()\n"
+    "{\n"
+    "    gl_FragColor = colour;\n"
+    "}\n";
+}  // namespace
+
+//=============================================================================
+ResponseCurveGLRenderer::ResponseCurveGLRenderer(juce::Component &ownerComponent)
+    : owner(ownerComponent), safeOwner(&ownerComponent) {
+  context.setRenderer(this);
+  context.setComponentPaintingEnabled(false);
+  context.setContinuousRepainting(false);
+}
+
+ResponseCurveGLRenderer::~ResponseCurveGLRenderer() { detach(); }
+
+void ResponseCurveGLRenderer::attach() {
+  if (!context.isAttached()) context.attachTo(owner);
+}
+
+void ResponseCurveGLRenderer::detach() {
+  if (context.isAttached()) context.detach();
+}
+
+bool ResponseCurveGLRenderer::isSoftwareRasteriser(const juce::String &rendererName) {
+  return rendererName.containsIgnoreCase("llvmpipe") ||
+         rendererName.containsIgnoreCase("softpipe") ||
+         rendererName.containsIgnoreCase("Software Rasterizer") ||
+         rendererName.containsIgnoreCase("SwiftShader") ||
+         rendererName.containsIgnoreCase("GDI Generic");
+}
+
+void ResponseCurveGLRenderer::fallBackToSoftware() {
+  // detach() blocks until the GL thread has stopped, so it has to be called from
+  // the message thread.
+  juce::MessageManager::callAsync([this, ownerPtr = safeOwner] {
+    if (ownerPtr != nullptr) {
+      detach();
+      ownerPtr->repaint();
+    }
+  });
+}
+
+//=============================================================================
+void ResponseCurveGLRenderer::setBackground(const juce::Image &image,
+                                            juce::Rectangle<int> newAnalysisArea) {
+  const juce::SpinLock::ScopedLockType sl(lock);
+  background = image;
+  backgroundChanged = true;
+  analysisArea = newAnalysisArea;
+}
+
+void ResponseCurveGLRenderer::setResponseCurve(const std::vector<double> &magsInDecibels,
+                                               double minDb, double maxDb) {
+  const auto numPoints = magsInDecibels.size();
+
+  if (numPoints < 2) return;
+
+  const juce::SpinLock::ScopedLockType sl(lock);
+  auto &v = pendingVertices[responseCurve];
+  v.resize(numPoints * 2);
+
+  for (size_t i = 0; i < numPoints; ++i) {
+    v[2 * i] = float(i) / float(numPoints);
+    v[2 * i + 1] = (float)juce::jmap(magsInDecibels[i], minDb, maxDb, 0.0, 1.0);
+  }
+}
+
+void ResponseCurveGLRenderer::setNumSpectra(int newNumSpectra) {
+  const juce::SpinLock::ScopedLockType sl(lock);
+  numSpectra = juce::jlimit(0, maxNumSpectra, newNumSpectra);
+}
+
+void ResponseCurveGLRenderer::setSpectrum(int spectrum, const float *fftDataInDecibels, int fftSize,
+                                          float binWidth, float negativeInfinity,
+                                          juce::Colour colour) {
+  jassert(juce::isPositiveAndBelow(spectrum, maxNumSpectra));
+
+  const auto numBins = fftSize / 2;
+
+  if (numBins < 2 || !juce::isPositiveAndBelow(spectrum, maxNumSpectra)) return;
+
+  // the x position of each bin only depends on the FFT size and sample rate
+  if (fftSize != binPositionsFFTSize || binWidth != binPositionsBinWidth) {
+    binPositions.resize(numBins);
+    binPositions[0] = 0.f;
+
+    for (int binNum = 1; binNum < numBins; ++binNum)
+      binPositions[binNum] = juce::mapFromLog10(binNum * binWidth, 20.f, 20000.f);
+
+    binPositionsFFTSize = fftSize;
+    binPositionsBinWidth = binWidth;
+  }
+
+  const juce::SpinLock::ScopedLockType sl(lock);
+  const auto curve = responseCurve + 1 + spectrum;
+  colours[curve] = colour;
+
+  auto &v = pendingVertices[curve];
+  v.resize(numBins * 2);
+
+  for (int binNum = 0; binNum < numBins; ++binNum) {
+    v[2 * binNum] = binPositions[binNum];
+    v[2 * binNum + 1] = juce::jmap(juce::jlimit(negativeInfinity, 0.f, fftDataInDecibels[binNum]),
+                                   negativeInfinity, 0.f, 0.f, 1.f);
+  }
+}
+
+//=============================================================================
+void ResponseCurveGLRenderer::newOpenGLContextCreated() {
+  using namespace juce::gl;
+
+  auto rendererName = juce::String((const char *)glGetString(GL_RENDERER));
+
+  if (isSoftwareRasteriser(rendererName)) {
+    DBG("ResponseCurveGLRenderer: software rasteriser (" << rendererName
+                                                         << "), using the software renderer");
+    fallBackToSoftware();
+    return;
+  }
+
+  shader = std::make_unique<juce::OpenGLShaderProgram>(context);
+
+  const auto vertexShader = juce::OpenGLHelpers::translateVertexShaderToV3(vertexShaderSource);
+  const auto fragmentShader =
+      juce::OpenGLHelpers::translateFragmentShaderToV3(fragmentShaderSource);
+
+  if (!shader->addVertexShader(vertexShader) || !shader->addFragmentShader(fragmentShader) ||
+      !shader->link()) {
+    DBG("ResponseCurveGLRenderer: " << shader->getLastError());
+    shader.reset();
+    fallBackToSoftware();
+    return;
+  }
+
+  areaUniform = std::make_unique<juce::OpenGLShaderProgram::Uniform>(*shader, "area");
+  colourUniform = std::make_unique<juce::OpenGLShaderProgram::Uniform>(*shader, "colour");
+  positionAttribute = glGetAttribLocation(shader->getProgramID(), "position");
+
+  glGenBuffers(numCurves, vertexBuffers.data());
+  needsUpload.fill(true);
+}
+
+void ResponseCurveGLRenderer::openGLContextClosing() {
+  using namespace juce::gl;
+
+  if (shader != nullptr) glDeleteBuffers(numCurves, vertexBuffers.data());
+
+  vertexBuffers.fill(0);
+  needsUpload.fill(true);
+  backgroundTexture.release();
+  areaUniform.reset();
+  colourUniform.reset();
+  shader.reset();
+}
+
+void ResponseCurveGLRenderer::renderOpenGL() {
+  using namespace juce::gl;
+
+  juce::OpenGLHelpers::clear(juce::Colours::black);
+
+  if (shader == nullptr) return;
+
+  juce::Image backgroundImage;
+  juce::Rectangle<int> area;
+  std::array<juce::Colour, numCurves> curveColours;
+  int numSpectraToDraw = 0;
+  bool uploadBackground = false;
+
+  {
+    const juce::SpinLock::ScopedLockType sl(lock);
+
+    for (int i = 0; i < numCurves; ++i) {
+      if (!pendingVertices[i].empty()) {
+        vertices[i].swap(pendingVertices[i]);
+        pendingVertices[i].clear();
+        needsUpload[i] = true;
+      }
+    }
+
+    backgroundImage = background;
+    uploadBackground = std::exchange(backgroundChanged, false);
+    area = analysisArea;
+    curveColours = colours;
+    numSpectraToDraw = numSpectra;
+  }
+
+  if (!backgroundImage.isValid() || area.isEmpty()) return;
+
+  const auto scale = (float)context.getRenderingScale();
+  const auto width = backgroundImage.getWidth();
+  const auto height = backgroundImage.getHeight();
+  const auto physicalWidth = juce::roundToInt(scale * width);
+  const auto physicalHeight = juce::roundToInt(scale * height);
+
+  // the grid only changes on resize, so it is uploaded once and then reused every frame
+  if (uploadBackground || backgroundTexture.getTextureID() == 0)
+    backgroundTexture.loadImage(backgroundImage);
+
+  glViewport(0, 0, physicalWidth, physicalHeight);
+
+  const juce::Rectangle<int> viewport(physicalWidth, physicalHeight);
+  backgroundTexture.bind();
+  context.copyTexture(viewport, viewport, physicalWidth, physicalHeight, false);
+  backgroundTexture.unbind();
+
+  // the strips are widened in pixels, so they have to be rebuilt when those change
+  if (area != stripArea || scale != stripScale) {
+    stripArea = area;
+    stripScale = scale;
+    needsUpload.fill(true);
+  }
+
+  const juce::Point<float> areaSize(scale * (float)area.getWidth(),
+                                    scale * (float)area.getHeight());
+
+  shader->use();
+
+  auto toNdcX = [width](int x) { return 2.f * (float)x / (float)width - 1.f; };
+  auto toNdcY = [height](int y) { return 1.f - 2.f * (float)y / (float)height; };
+
+  areaUniform->set(toNdcX(area.getX()), toNdcY(area.getBottom()), toNdcX(area.getRight()),
+                   toNdcY(area.getY()));
+
+  glEnable(GL_SCISSOR_TEST);
+  glScissor(juce::roundToInt(scale * area.getX()),
+            juce::roundToInt(scale * (height - area.getBottom())),
+            juce::roundToInt(scale * area.getWidth()), juce::roundToInt(scale * area.getHeight()));
+
+  for (int spectrum = 0; spectrum < numSpectraToDraw; ++spectrum)
+    drawCurve(responseCurve + 1 + spectrum, curveColours[responseCurve + 1 + spectrum],
+              scale * 1.f, areaSize);
+
+  drawCurve(responseCurve, juce::Colours::white, scale * 2.f, areaSize);
+
+  glDisable(GL_SCISSOR_TEST);
+
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void ResponseCurveGLRenderer::buildStrip(int curve, float lineWidth,
+                                         juce::Point<float> areaSize) {
+  // core profiles don't draw lines wider than 1 pixel, so each point is pushed half the
+  // width out to either side, across the direction of the curve at that point
+  const auto &v = vertices[curve];
+  const auto numPoints = v.size() / 2;
+  const auto halfWidth = 0.5f * lineWidth;
+
+  auto &strip = strips[curve];
+  strip.resize(numPoints * 4);
+
+  for (size_t i = 0; i < numPoints; ++i) {
+    const auto prev = i > 0 ? i - 1 : i;
+    const auto next = i + 1 < numPoints ? i + 1 : i;
+
+    const auto dx = (v[2 * next] - v[2 * prev]) * areaSize.x;
+    const auto dy = (v[2 * next + 1] - v[2 * prev + 1]) * areaSize.y;
+    const auto length = std::sqrt(dx * dx + dy * dy);
+
+    const auto nx = length > 0.f ? -dy / length * halfWidth / areaSize.x : 0.f;
+    const auto ny = length > 0.f ? dx / length * halfWidth / areaSize.y : halfWidth / areaSize.y;
+
+    strip[4 * i] = v[2 * i] + nx;
+    strip[4 * i + 1] = v[2 * i + 1] + ny;
+    strip[4 * i + 2] = v[2 * i] - nx;
+    strip[4 * i + 3] = v[2 * i + 1] - ny;
+  }
+}
+
+void ResponseCurveGLRenderer::drawCurve(int curve, juce::Colour colour, float lineWidth,
+                                        juce::Point<float> areaSize) {
+  using namespace juce::gl;
+
+  const auto &v = vertices[curve];
+
+  if (v.size() < 4 || positionAttribute < 0 || areaSize.x <= 0.f || areaSize.y <= 0.f) return;
+
+  colourUniform->set(colour.getFloatRed(), colour.getFloatGreen(), colour.getFloatBlue(),
+                     colour.getFloatAlpha());
+
+  glBindBuffer(GL_ARRAY_BUFFER, vertexBuffers[curve]);
+
+  if (needsUpload[curve]) {
+    buildStrip(curve, lineWidth, areaSize);
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)(strips[curve].size() * sizeof(float)),
+                 strips[curve].data(), GL_STREAM_DRAW);
+    needsUpload[curve] = false;
+  }
+
+  glEnableVertexAttribArray((GLuint)positionAttribute);
+  glVertexAttribPointer((GLuint)positionAttribute, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+
+  glDrawArrays(GL_TRIANGLE_STRIP, 0, (GLsizei)(strips[curve].size() / 2));
+
+  glDisableVertexAttribArray((GLuint)positionAttribute);
+}
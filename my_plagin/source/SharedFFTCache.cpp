@@ -0,0 +1,26 @@
+#include "eq_plagin/SharedFFTCache.h"
+
+std::shared_ptr<const SharedFFTCache::FFT> SharedFFTCache::getFFT(int order) {
+  const juce::ScopedLock sl(lock);
+
+  auto &entry = ffts[order];
+
+  if (auto fft = entry.lock()) return fft;
+
+  auto fft = std::make_shared<const FFT>(order);
+  entry = fft;
+  return fft;
+}
+
+std::shared_ptr<const SharedFFTCache::Window> SharedFFTCache::getWindow(int size,
+                                                                        WindowType type) {
+  const juce::ScopedLock sl(lock);
+
+  auto &entry = windows[{size, type}];
+
+  if (auto window = entry.lock()) return window;
+
+  auto window = std::make_shared<const Window>((size_t)size, type);
+  entry = window;
+  return window;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <juce_gui_basics/juce_gui_basics.h>
+
+#include "DirectoryScanner.h"
+
+//==============================================================================
+/*
+  A file tree for picking audio files, filled by the shared DirectoryScanner
+  instead of a DirectoryContentsList. A folder is listed when it is first
+  opened and its entries appear while the scan is still running. Reports to
+  the same FileBrowserListener interface as FileTreeComponent.
+*/
+class AudioFileBrowser : public juce::TreeView {
+ public:
+  AudioFileBrowser();
+  ~AudioFileBrowser() override;
+
+  // only files with one of these extensions are shown, e.g. "*.wav;*.aiff"
+  void setFileWildcards(const juce::String& wildcards);
+
+  void setRoot(const juce::File& directory);
+  juce::File getSelectedFile() const;
+
+  void addListener(juce::FileBrowserListener* listener);
+  void removeListener(juce::FileBrowserListener* listener);
+
+ private:
+  class FileItem;
+
+  juce::SharedResourcePointer<DirectoryScanner> scanner;
+  juce::ListenerList<juce::FileBrowserListener> listeners;
+  std::unique_ptr<FileItem> rootItem;
+
+  JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AudioFileBrowser)
+};
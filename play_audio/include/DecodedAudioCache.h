@@ -0,0 +1,275 @@
+#pragma once
+
+#include <juce_audio_formats/juce_audio_formats.h>
+
+#include <functional>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// local files are keyed by size and modification time as well, so an edited file is re-read
+inline juce::String makeAudioFileCacheKey(const juce::URL& url) {
+  if (!url.isLocalFile()) return url.toString(false);
+
+  auto file = url.getLocalFile();
+  return file.getFullPathName() + "|" + juce::String(file.getSize()) + "|" +
+         juce::String(file.getLastModificationTime().toMilliseconds());
+}
+
+//==============================================================================
+/*
+  A file decoded to float PCM in fixed-size chunks. Each chunk is written once
+  by the decoder and then published, so any thread can read the chunks that
+  are ready without locking.
+*/
+struct DecodedAudioFile {
+  static constexpr int chunkSize = 1 << 16;
+  static constexpr int numChannels = 2;
+
+  explicit DecodedAudioFile(juce::int64 length)
+      : lengthInSamples(length),
+        numChunks(static_cast<int>((length + chunkSize - 1) / chunkSize)),
+        chunks(static_cast<size_t>(numChunks)),
+        ready(new std::atomic<bool>[static_cast<size_t>(numChunks)]) {
+    for (int i = 0; i < numChunks; ++i) ready[i] = false;
+  }
+
+  bool isReady(int chunk) const { return ready[chunk].load(std::memory_order_acquire); }
+
+  const juce::AudioBuffer<float>& getChunk(int chunk) const {
+    jassert(isReady(chunk));
+    return *chunks[static_cast<size_t>(chunk)];
+  }
+
+  int getNumDecoded() const { return numDecoded.load(); }
+  bool isComplete() const { return getNumDecoded() == numChunks; }
+
+  size_t getSizeInBytes() const {
+    return sizeof(float) * numChannels * static_cast<size_t>(lengthInSamples);
+  }
+
+  // decoder side: the first chunk still missing at or after the one playback wants, or -1
+  int getNextChunkToDecode() const {
+    const auto wanted = juce::jlimit(0, juce::jmax(0, numChunks - 1), wantedChunk.load());
+
+    for (int i = 0; i < numChunks; ++i) {
+      const auto chunk = (wanted + i) % numChunks;
+
+      if (!isReady(chunk)) return chunk;
+    }
+
+    return -1;
+  }
+
+  void publish(int chunk, std::unique_ptr<juce::AudioBuffer<float>> buffer) {
+    chunks[static_cast<size_t>(chunk)] = std::move(buffer);
+    ready[chunk].store(true, std::memory_order_release);
+    ++numDecoded;
+  }
+
+  const juce::int64 lengthInSamples;
+  const int numChunks;
+
+  // set by playback, so the decoder continues from wherever the user has scrubbed to
+  std::atomic<int> wantedChunk{0};
+  std::atomic<bool> evicted{false};
+  std::atomic<bool> isBeingDecoded{false};
+
+ private:
+  std::vector<std::unique_ptr<juce::AudioBuffer<float>>> chunks;
+  std::unique_ptr<std::atomic<bool>[]> ready;
+  std::atomic<int> numDecoded{0};
+};
+//==============================================================================
+/*
+  Decodes one chunk per run and then goes to the back of the pool's queue, so
+  several files being decoded share the decoder threads. There is at most one
+  job per file: whoever starts it has set isBeingDecoded.
+*/
+struct DecodeJob : juce::ThreadPoolJob {
+  DecodeJob(std::shared_ptr<DecodedAudioFile> f, std::unique_ptr<juce::AudioFormatReader> r)
+      : juce::ThreadPoolJob("Decode"), file(std::move(f)), reader(std::move(r)) {
+    jassert(file->isBeingDecoded);
+  }
+
+  ~DecodeJob() override { file->isBeingDecoded = false; }
+
+  JobStatus runJob() override {
+    if (shouldExit() || file->evicted) return jobHasFinished;
+
+    const auto chunk = file->getNextChunkToDecode();
+
+    if (chunk < 0) return jobHasFinished;
+
+    const auto start = static_cast<juce::int64>(chunk) * DecodedAudioFile::chunkSize;
+    const auto numSamples = static_cast<int>(
+        juce::jmin<juce::int64>(DecodedAudioFile::chunkSize, file->lengthInSamples - start));
+
+    auto buffer =
+        std::make_unique<juce::AudioBuffer<float>>(DecodedAudioFile::numChannels, numSamples);
+    reader->read(buffer.get(), 0, numSamples, start, true, true);
+    file->publish(chunk, std::move(buffer));
+
+    return jobNeedsRunningAgain;
+  }
+
+  std::shared_ptr<DecodedAudioFile> file;
+  std::unique_ptr<juce::AudioFormatReader> reader;
+};
+//==============================================================================
+/*
+  Decoded compressed files shared by every player in the process, so playing,
+  scrubbing or looping a file again does not decode it again. Files are
+  dropped, least recently used first, once the cache grows past its budget;
+  players still holding one keep it until they let go.
+*/
+struct DecodedAudioCache {
+  static constexpr size_t defaultBudgetInBytes = 512 * 1024 * 1024;
+
+  using ReaderFactory = std::function<std::unique_ptr<juce::AudioFormatReader>()>;
+
+  void setMemoryBudget(size_t bytes) {
+    const juce::ScopedLock sl(lock);
+    budgetInBytes = bytes;
+    evictOverBudget();
+  }
+
+  /*
+    Returns the file, decoded as far as it has got, and (re)starts its decoder on
+    the pool if it is unfinished. Returns nullptr if the file does not fit in the
+    budget at all.
+  */
+  std::shared_ptr<DecodedAudioFile> getOrStartDecoding(const juce::String& key,
+                                                       juce::int64 lengthInSamples,
+                                                       const ReaderFactory& createReader,
+                                                       juce::ThreadPool& pool) {
+    std::shared_ptr<DecodedAudioFile> file;
+
+    {
+      const juce::ScopedLock sl(lock);
+
+      if (auto found = entries.find(key); found != entries.end()) {
+        lru.splice(lru.begin(), lru, found->second);
+        file = found->second->file;
+      } else {
+        if (lengthInSamples <= 0) return nullptr;
+
+        file = std::make_shared<DecodedAudioFile>(lengthInSamples);
+
+        if (file->getSizeInBytes() > budgetInBytes) return nullptr;
+
+        lru.push_front({key, file});
+        entries[key] = lru.begin();
+        totalBytes += file->getSizeInBytes();
+        evictOverBudget();
+      }
+    }
+
+    bool expected = false;
+
+    if (!file->isComplete() && file->isBeingDecoded.compare_exchange_strong(expected, true)) {
+      if (auto reader = createReader())
+        pool.addJob(new DecodeJob(file, std::move(reader)), true);
+      else
+        file->isBeingDecoded = false;
+    }
+
+    return file;
+  }
+
+ private:
+  struct Entry {
+    juce::String key;
+    std::shared_ptr<DecodedAudioFile> file;
+  };
+
+  void evictOverBudget() {
+    while (totalBytes > budgetInBytes && !lru.empty()) {
+      auto& victim = lru.back();
+      victim.file->evicted = true;
+      totalBytes -= victim.file->getSizeInBytes();
+      entries.erase(victim.key);
+      lru.pop_back();
+    }
+  }
+
+  juce::CriticalSection lock;
+  std::list<Entry> lru;
+  std::unordered_map<juce::String, std::list<Entry>::iterator> entries;
+  size_t totalBytes = 0;
+  size_t budgetInBytes = defaultBudgetInBytes;
+};
+//==============================================================================
+/*
+  Reads the chunks of a DecodedAudioFile that are ready and falls back to the
+  file's own reader for the rest.
+*/
+struct DecodedAudioSource : juce::PositionableAudioSource {
+  DecodedAudioSource(std::shared_ptr<DecodedAudioFile> f, juce::PositionableAudioSource& s)
+      : file(std::move(f)), fallback(s) {}
+
+  void prepareToPlay(int samplesPerBlockExpected, double sampleRate) override {
+    fallback.prepareToPlay(samplesPerBlockExpected, sampleRate);
+  }
+
+  void releaseResources() override { fallback.releaseResources(); }
+
+  void getNextAudioBlock(const juce::AudioSourceChannelInfo& info) override {
+    auto& buffer = *info.buffer;
+    const auto length = file->lengthInSamples;
+    int done = 0;
+
+    while (done < info.numSamples) {
+      const auto readPos = looping ? position % length : position;
+      const auto startSample = info.startSample + done;
+
+      if (readPos >= length) {
+        buffer.clear(startSample, info.numSamples - done);
+        position += info.numSamples - done;
+        break;
+      }
+
+      const auto chunk = static_cast<int>(readPos / DecodedAudioFile::chunkSize);
+      const auto offset = static_cast<int>(readPos % DecodedAudioFile::chunkSize);
+      const auto numSamples = static_cast<int>(juce::jmin<juce::int64>(
+          info.numSamples - done, DecodedAudioFile::chunkSize - offset, length - readPos));
+
+      file->wantedChunk.store(chunk, std::memory_order_relaxed);
+
+      if (file->isReady(chunk)) {
+        const auto& decoded = file->getChunk(chunk);
+
+        for (int ch = 0; ch < buffer.getNumChannels(); ++ch) {
+          if (ch < decoded.getNumChannels())
+            buffer.copyFrom(ch, startSample, decoded, ch, offset, numSamples);
+          else
+            buffer.clear(ch, startSample, numSamples);
+        }
+      } else {
+        if (fallback.getNextReadPosition() != readPos) fallback.setNextReadPosition(readPos);
+
+        fallback.getNextAudioBlock(juce::AudioSourceChannelInfo(&buffer, startSample, numSamples));
+      }
+
+      done += numSamples;
+      position += numSamples;
+    }
+  }
+
+  void setNextReadPosition(juce::int64 newPosition) override { position = newPosition; }
+
+  juce::int64 getNextReadPosition() const override {
+    return looping ? position % file->lengthInSamples : position;
+  }
+
+  juce::int64 getTotalLength() const override { return file->lengthInSamples; }
+  bool isLooping() const override { return looping; }
+  void setLooping(bool shouldLoop) override { looping = shouldLoop; }
+
+ private:
+  std::shared_ptr<DecodedAudioFile> file;
+  juce::PositionableAudioSource& fallback;
+  juce::int64 position = 0;
+  bool looping = false;
+};
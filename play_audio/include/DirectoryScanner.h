@@ -0,0 +1,180 @@
+#pragma once
+
+#include <juce_events/juce_events.h>
+
+#include <atomic>
+#include <functional>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+//==============================================================================
+/*
+  Lists directories for the file browser on its own low-priority threads, so
+  browsing never competes with the playback read-ahead thread.
+
+  Files are accepted by their extension alone and never opened. Results reach
+  the message thread in batches while the directory is still being read, and
+  complete listings are kept, keyed by the directory's modification time, so
+  going back to a directory that has not changed costs nothing.
+*/
+class DirectoryScanner {
+ public:
+  struct Entry {
+    juce::File file;
+    bool isDirectory = false;
+  };
+
+  using Listing = std::vector<Entry>;
+
+  // called on the message thread for every batch, with isComplete set on the last one
+  using Callback = std::function<void(const Listing& batch, bool isComplete)>;
+
+  // set it to true to cancel a scan; dropping it does not cancel
+  using Token = std::shared_ptr<std::atomic<bool>>;
+
+  static constexpr int batchSize = 64;
+  static constexpr size_t maxCachedDirectories = 256;
+
+  DirectoryScanner()
+      : pool(juce::ThreadPoolOptions{}
+                 .withThreadName("Directory scanner")
+                 .withNumberOfThreads(2)
+                 .withDesiredThreadPriority(juce::Thread::Priority::low)) {}
+
+  ~DirectoryScanner() { pool.removeAllJobs(true, 4000); }
+
+  // e.g. AudioFormatManager::getWildcardForAllFormats(); changing the set of extensions
+  // forgets every listing, setting the same one again keeps them
+  void setFileWildcards(const juce::String& wildcards) {
+    std::unordered_set<juce::String> newExtensions;
+
+    for (auto& pattern : juce::StringArray::fromTokens(wildcards, ";,", "\"'"))
+      newExtensions.insert(pattern.fromLastOccurrenceOf(".", false, false).trim().toLowerCase());
+
+    const juce::ScopedLock sl(lock);
+
+    if (newExtensions == extensions) return;
+
+    extensions = std::move(newExtensions);
+    ++extensionsGeneration;
+    lru.clear();
+    entries.clear();
+  }
+
+  Token scan(const juce::File& directory, Callback onBatch) {
+    auto token = std::make_shared<std::atomic<bool>>(false);
+
+    pool.addJob([this, directory, token, onBatch = std::move(onBatch)] {
+      run(directory, token, onBatch);
+    });
+
+    return token;
+  }
+
+ private:
+  void run(const juce::File& directory, const Token& token, const Callback& onBatch) {
+    const auto modified = directory.getLastModificationTime();
+    const auto generation = getExtensionsGeneration();
+
+    if (auto cached = findCached(directory, modified)) {
+      deliver(token, onBatch, *cached, true);
+      return;
+    }
+
+    auto listing = std::make_shared<Listing>();
+    Listing batch;
+
+    for (const auto& entry : juce::RangedDirectoryIterator(
+             directory, false, "*",
+             juce::File::findFilesAndDirectories | juce::File::ignoreHiddenFiles)) {
+      if (token->load()) return;
+
+      if (!entry.isDirectory() && !isAcceptedFile(entry.getFile())) continue;
+
+      batch.push_back({entry.getFile(), entry.isDirectory()});
+
+      if (static_cast<int>(batch.size()) == batchSize) {
+        listing->insert(listing->end(), batch.begin(), batch.end());
+        deliver(token, onBatch, std::move(batch), false);
+        batch = {};
+      }
+    }
+
+    listing->insert(listing->end(), batch.begin(), batch.end());
+    store(directory, modified, generation, listing);
+    deliver(token, onBatch, std::move(batch), true);
+  }
+
+  static void deliver(const Token& token, const Callback& onBatch, Listing batch,
+                      bool isComplete) {
+    juce::MessageManager::callAsync([token, onBatch, batch = std::move(batch), isComplete] {
+      if (!token->load()) onBatch(batch, isComplete);
+    });
+  }
+
+  int getExtensionsGeneration() const {
+    const juce::ScopedLock sl(lock);
+    return extensionsGeneration;
+  }
+
+  bool isAcceptedFile(const juce::File& file) const {
+    const juce::ScopedLock sl(lock);
+    return extensions.count(file.getFileExtension().substring(1).toLowerCase()) > 0;
+  }
+
+  std::shared_ptr<const Listing> findCached(const juce::File& directory, juce::Time modified) {
+    const juce::ScopedLock sl(lock);
+    auto found = entries.find(directory.getFullPathName());
+
+    if (found == entries.end()) return nullptr;
+
+    if (found->second->modified != modified) {
+      lru.erase(found->second);
+      entries.erase(found);
+      return nullptr;
+    }
+
+    lru.splice(lru.begin(), lru, found->second);
+    return found->second->listing;
+  }
+
+  void store(const juce::File& directory, juce::Time modified, int generation,
+             std::shared_ptr<const Listing> listing) {
+    const juce::ScopedLock sl(lock);
+
+    // the extensions changed while this directory was being read
+    if (generation != extensionsGeneration) return;
+
+    const auto path = directory.getFullPathName();
+
+    if (auto found = entries.find(path); found != entries.end()) {
+      lru.erase(found->second);
+      entries.erase(found);
+    }
+
+    lru.push_front({path, modified, std::move(listing)});
+    entries[path] = lru.begin();
+
+    while (lru.size() > maxCachedDirectories) {
+      entries.erase(lru.back().path);
+      lru.pop_back();
+    }
+  }
+
+  struct Cached {
+    juce::String path;
+    juce::Time modified;
+    std::shared_ptr<const Listing> listing;
+  };
+
+  mutable juce::CriticalSection lock;
+  std::unordered_set<juce::String> extensions;
+  int extensionsGeneration = 0;
+  std::list<Cached> lru;
+  std::unordered_map<juce::String, std::list<Cached>::iterator> entries;
+
+  juce::ThreadPool pool;
+};
@@ -10,6 +10,8 @@
 
 
 #include "PluginProcessor.h"
+#include "AudioFileBrowser.h"
+#include "WaveformThumbnailCache.h"
 
 using namespace juce;
 
@@ -22,7 +24,6 @@ inline Colour getUIColourIfAvailable (LookAndFeel_V4::ColourScheme::UIColour uiC
 }
 
 class DemoThumbnailComp  : public Component,
-public ChangeListener,
 public FileDragAndDropTarget,
 public ChangeBroadcaster,
 private ScrollBar::Listener,
@@ -49,8 +50,6 @@ public:
     
     void resized() override;
     
-    void changeListenerCallback (ChangeBroadcaster*) override;
-    
     bool isInterestedInFileDrag (const StringArray& /*files*/) override;
     
     void filesDropped (const StringArray& files, int /*x*/, int /*y*/) override;
@@ -67,14 +66,20 @@ private:
     Slider& zoomSlider;
     ScrollBar scrollbar  { false };
     
-    AudioThumbnailCache thumbnailCache  { 5 };
-    AudioThumbnail thumbnail;
+    AudioFormatManager& formatManager;
+    WaveformThumbnailCache thumbnailCache;
+    WaveformThumbnailCache::Pyramid waveform;
+    URL waveformURL;
     Range<double> visibleRange;
     bool isFollowingTransport = false;
     URL lastFileDropped;
     
     DrawableRectangle currentPositionMarker;
     
+    double getTotalLength() const noexcept;
+    
+    void drawWaveform (Graphics& g, Rectangle<int> area) const;
+    
     float timeToX (const double time) const;
     
     double xToTime (const float x) const;
@@ -107,8 +112,7 @@ private:
     // if this PIP is running inside the demo runner, we'll use the shared device manager instead
     AudioFilePlayerAudioProcessor& audioProcessor;
     
-    DirectoryContentsList directoryList;
-    FileTreeComponent fileTreeComp {directoryList};
+    AudioFileBrowser fileTreeComp;
     Label explanation { {}, "Select an audio file in the treeview above, and this page will display its waveform, and let you play it.." };
     
     /*
@@ -121,6 +125,11 @@ private:
     Label zoomLabel                     { {}, "zoom:" };
     Slider zoomSlider                   { Slider::LinearHorizontal, Slider::NoTextBox };
     ToggleButton followTransportButton  { "Follow Transport" };
+    ToggleButton loopButton             { "Loop" };
+    ToggleButton syncToHostButton       { "Sync To Host" };
+    AudioProcessorValueTreeState::ButtonAttachment syncToHostAttachment { audioProcessor.apvts,
+                                                                          Params::GetParamNames().at (Params::Names::Sync_To_Host),
+                                                                          syncToHostButton };
     TextButton startStopButton          { "Load an audio file first..." };
     
     ReferencedTransportSourceData::Ptr activeSource;
@@ -15,14 +15,38 @@
 #include <juce_core/juce_core.h>
 #include <juce_dsp/juce_dsp.h>
 
+#include <list>
+#include <unordered_map>
+#include <utility>
+
+#include "DecodedAudioCache.h"
+#include "ReleasePool.h"
+#include "SincResamplingAudioSource.h"
+
 
 using namespace juce;
 //==============================================================================
 namespace Params {
-enum class Names {};
+enum class Names {
+  Resampler_Quality,
+  Sync_To_Host,
+  Decode_Cache_Size,
+  Head_Cache_Size,
+  Crossfade,
+  Loop_Start,
+  Loop_End
+};
 
 inline const std::map<Names, juce::String>& GetParamNames() {
-  static std::map<Names, juce::String> names = {};
+  static std::map<Names, juce::String> names = {
+      {Names::Resampler_Quality, "Resampler Quality"},
+      {Names::Sync_To_Host, "Sync To Host"},
+      {Names::Decode_Cache_Size, "Decode Cache Size"},
+      {Names::Head_Cache_Size, "Head Cache Size"},
+      {Names::Crossfade, "Crossfade"},
+      {Names::Loop_Start, "Loop Start"},
+      {Names::Loop_End, "Loop End"},
+  };
 
   return names;
 }
@@ -46,7 +70,8 @@ struct Fifo {
   bool pull(T& t) {
     auto read = fifo.read(1);
     if (read.blockSize1 > 0) {
-      t = buffer[static_cast<size_t>(read.startIndex1)];
+      // emptied, so the slot does not keep the pulled object alive
+      t = std::exchange(buffer[static_cast<size_t>(read.startIndex1)], T{});
       return true;
     }
 
@@ -62,145 +87,1015 @@ struct Fifo {
   std::array<T, Size> buffer;
 };
 //==============================================================================
-template <typename ReferenceCountedType>
-struct ReleasePool : juce::Timer {
-  ReleasePool() {
-    deletionPool.reserve(5000);
+/*
+  Touches the pages of a memory-mapped reader ahead of the play cursor from a
+  background thread, so the audio thread reads straight from the page cache
+  instead of faulting them in itself.
+
+  The play cursor is read from another thread, so the source must report its
+  position atomically; it may run at another rate than the file.
+*/
+struct MappedFilePrefetcher : juce::TimeSliceClient {
+  MappedFilePrefetcher(const MemoryMappedAudioFormatReader& r, const PositionableAudioSource& s,
+                       double sourceSampleRate, double secondsAhead = 2.0)
+      : reader(r),
+        source(s),
+        fileSamplesPerSourceSample(sourceSampleRate > 0 ? r.sampleRate / sourceSampleRate : 1.0),
+        samplesAhead(static_cast<int64>(secondsAhead * r.sampleRate)),
+        samplesPerPage(juce::jmax(1, pageSize / juce::jmax(1, static_cast<int>(r.numChannels) *
+                                                                  r.bitsPerSample / 8))) {}
+
+  int useTimeSlice() override {
+    auto cursor = static_cast<int64>(static_cast<double>(source.getNextReadPosition()) *
+                                     fileSamplesPerSourceSample);
+    auto mapped = reader.getMappedSection();
+
+    // seeking or looping back invalidates what has been prefetched so far
+    if (cursor < lastCursor || cursor > prefetchedUpTo) prefetchedUpTo = cursor;
+
+    lastCursor = cursor;
+
+    auto start = juce::jmax(prefetchedUpTo, mapped.getStart());
+    auto end = juce::jmin(cursor + samplesAhead, mapped.getEnd());
 
-    startTimer(1 * 1000);
+    for (auto sample = start; sample < end; sample += samplesPerPage) reader.touchSample(sample);
+
+    prefetchedUpTo = juce::jmax(prefetchedUpTo, end);
+
+    return 20;
   }
 
-  ~ReleasePool() override { stopTimer(); }
+ private:
+  static constexpr int pageSize = 4096;
 
-  using Ptr = typename ReferenceCountedType::Ptr;
+  const MemoryMappedAudioFormatReader& reader;
+  const PositionableAudioSource& source;
+  const double fileSamplesPerSourceSample;
+  const int64 samplesAhead;
+  const int samplesPerPage;
 
-  void add(Ptr ptr) {
-    if (ptr == nullptr) return;
+  int64 lastCursor = 0;
+  int64 prefetchedUpTo = 0;
+};
+//==============================================================================
+/*
+  The first few seconds of recently played files, decoded to float and shared
+  by every player in the process. The least recently used heads are dropped
+  once the cache grows past its budget.
+*/
+struct AudioFileHeadCache {
+  using Head = std::shared_ptr<const juce::AudioBuffer<float>>;
 
-    if (juce::MessageManager::getInstance()->isThisTheMessageThread()) {
-      addIfNotAlreadyThere(ptr);
-    } else {
-      if (fifo.push(ptr)) {
-        successfullyAdded.set(true);
-      } else {
-        jassertfalse;
-      }
-    }
+  static constexpr size_t defaultBudgetInBytes = 64 * 1024 * 1024;
+
+  void setMemoryBudget(size_t bytes) {
+    const juce::ScopedLock sl(lock);
+    budgetInBytes = bytes;
+    evictOverBudget();
   }
 
-  void timerCallback() override {
-    if (successfullyAdded.compareAndSetBool(false, true)) {
-      Ptr ptr;
-      while (fifo.pull(ptr)) {
-        addIfNotAlreadyThere(ptr);
-        ptr = nullptr;
+  // called on the loader threads; the source is left wherever the head ends
+  Head getOrLoad(const juce::String& key, PositionableAudioSource& source, int numChannels,
+                 int numSamples) {
+    {
+      const juce::ScopedLock sl(lock);
+
+      if (auto found = entries.find(key); found != entries.end()) {
+        lru.splice(lru.begin(), lru, found->second);
+        return found->second->head;
       }
     }
 
-    deletionPool.erase(
-        std::remove_if(deletionPool.begin(), deletionPool.end(),
-                       [](const auto& ptr) { return ptr->getReferenceCount() <= 1; }),
-        deletionPool.end());
+    auto buffer = std::make_shared<juce::AudioBuffer<float>>(numChannels, numSamples);
+    source.setNextReadPosition(0);
+    source.getNextAudioBlock(AudioSourceChannelInfo(buffer.get(), 0, numSamples));
+
+    const juce::ScopedLock sl(lock);
+
+    // another player may have loaded the same file meanwhile
+    if (auto found = entries.find(key); found != entries.end()) return found->second->head;
+
+    lru.push_front({key, buffer});
+    entries[key] = lru.begin();
+    totalBytes += bytesFor(*buffer);
+    evictOverBudget();
+
+    return buffer;
   }
 
  private:
-  Fifo<Ptr, 512> fifo;
-  std::vector<Ptr> deletionPool;
-  juce::Atomic<bool> successfullyAdded{false};
+  struct Entry {
+    juce::String key;
+    Head head;
+  };
 
-  void addIfNotAlreadyThere(Ptr ptr) {
-    auto found = std::find_if(deletionPool.begin(), deletionPool.end(),
-                              [ptr](const auto& elem) { return elem.get() == ptr.get(); });
+  static size_t bytesFor(const juce::AudioBuffer<float>& b) {
+    return sizeof(float) * static_cast<size_t>(b.getNumChannels() * b.getNumSamples());
+  }
 
-    if (found == deletionPool.end()) deletionPool.push_back(ptr);
+  // the most recent head stays, whatever its size, so the file just opened can still use it
+  void evictOverBudget() {
+    while (totalBytes > budgetInBytes && lru.size() > 1) {
+      totalBytes -= bytesFor(*lru.back().head);
+      entries.erase(lru.back().key);
+      lru.pop_back();
+    }
   }
+
+  juce::CriticalSection lock;
+  std::list<Entry> lru;
+  std::unordered_map<juce::String, std::list<Entry>::iterator> entries;
+  size_t totalBytes = 0;
+  size_t budgetInBytes = defaultBudgetInBytes;
+};
+//==============================================================================
+/*
+  Plays the cached head of a file straight from RAM and hands over to the
+  streaming source after it. While the head plays, the streaming source is
+  parked at the end of the head, so its read-ahead is already full when the
+  cursor gets there.
+*/
+struct HeadCachedAudioSource : juce::PositionableAudioSource {
+  HeadCachedAudioSource(AudioFileHeadCache::Head h, PositionableAudioSource& s)
+      : head(std::move(h)), streaming(s), headLength(head->getNumSamples()) {
+    streaming.setNextReadPosition(headLength);
+  }
+
+  void prepareToPlay(int samplesPerBlockExpected, double sampleRate) override {
+    // the loader has already prepared the streaming source, so this is normally a no-op
+    streaming.prepareToPlay(samplesPerBlockExpected, sampleRate);
+  }
+
+  // the streaming source keeps its buffers until the owner is deleted on the message thread
+  void releaseResources() override {}
+
+  void getNextAudioBlock(const AudioSourceChannelInfo& info) override {
+    const auto pos = position.load();
+    const auto fromHead =
+        static_cast<int>(juce::jlimit<int64>(0, info.numSamples, headLength - pos));
+
+    if (fromHead > 0) {
+      for (int ch = 0; ch < info.buffer->getNumChannels(); ++ch)
+        info.buffer->copyFrom(ch, info.startSample, *head,
+                              juce::jmin(ch, head->getNumChannels() - 1), static_cast<int>(pos),
+                              fromHead);
+    }
+
+    if (fromHead < info.numSamples) {
+      AudioSourceChannelInfo rest(info.buffer, info.startSample + fromHead,
+                                  info.numSamples - fromHead);
+      streaming.getNextAudioBlock(rest);
+    }
+
+    position = pos + info.numSamples;
+  }
+
+  void setNextReadPosition(int64 newPosition) override {
+    position = newPosition;
+    streaming.setNextReadPosition(juce::jmax(newPosition, headLength));
+  }
+
+  int64 getNextReadPosition() const override { return position.load(); }
+  int64 getTotalLength() const override { return streaming.getTotalLength(); }
+  bool isLooping() const override { return streaming.isLooping(); }
+  void setLooping(bool shouldLoop) override { streaming.setLooping(shouldLoop); }
+
+ private:
+  const AudioFileHeadCache::Head head;
+  PositionableAudioSource& streaming;
+  const int64 headLength;
+  std::atomic<int64> position{0};
 };
 //==============================================================================
 struct ReferencedTransportSourceData : juce::ReferenceCountedObject {
   using Ptr = juce::ReferenceCountedObjectPtr<ReferencedTransportSourceData>;
 
+  // what the playlist does with this source when it arrives on the audio thread
+  enum class Role { replace, append, loopPartner, seek };
+
+  ~ReferencedTransportSourceData() override {
+    // the ReleasePool makes sure this runs on the message thread, never on the audio thread
+    if (prefetcher != nullptr) prefetchThread->removeTimeSliceClient(prefetcher.get());
+  }
+
+  // memory-mapped sources are read straight from the page cache and need no read-ahead buffer
+  bool isMemoryMapped() const { return prefetcher != nullptr; }
+
   std::unique_ptr<AudioFormatReaderSource> currentAudioFileSource;
+  // compressed files: PCM from the shared decode cache where it is ready, the reader elsewhere
+  std::unique_ptr<DecodedAudioSource> decodedSource;
   juce::URL currentAudioFile;
   double audioFileSourceSampleRate{0};
+  // the rate the playback source delivers: the host rate once the file has been resampled
+  double playbackSampleRate{0};
+
+  std::unique_ptr<MappedFilePrefetcher> prefetcher;
+  TimeSliceThread* prefetchThread = nullptr;
+
+  // what the transport plays: the cached head, then either the mapped file or the read-ahead,
+  // which resamples to the host rate where needed
+  std::unique_ptr<SincResamplingAudioSource> resamplingSource;
+  std::unique_ptr<BufferingAudioSource> bufferingSource;
+  std::unique_ptr<HeadCachedAudioSource> playbackSource;
+
+  Role role = Role::replace;
+};
+//==============================================================================
+/*
+  The one source the transport plays: the current file, the files queued
+  after it and an optional loop region.
+
+  Sources arrive through the processor's fifo and are only touched on the
+  audio thread; the message thread seeks and reads the position through
+  atomics. Transitions happen on the exact sample, crossfaded if a crossfade
+  length is set, and sources that are no longer needed go to the ReleasePool.
+
+  A jump back to the loop start lands on a second instance of the same file
+  (the loop partner), already positioned there, so it does not wait for a
+  read-ahead refill. After each jump the two instances swap roles.
+
+  Seeks work the same way: the current instance fades out and the playlist
+  stays silent until the loader delivers one already buffered at the target,
+  so the audio thread never repositions a read-ahead itself. While the host
+  drives the clock, the target lies a little ahead of the seek and the new
+  instance starts on the exact sample the clock reaches it.
+*/
+struct PlaylistAudioSource : juce::PositionableAudioSource {
+  using Ptr = ReferencedTransportSourceData::Ptr;
+  using Role = ReferencedTransportSourceData::Role;
+
+  static constexpr int maxQueued = 16;
+  // a file picked while playing replaces the current one with this short fade instead of a click
+  static constexpr int replaceFadeSamples = 256;
+
+  explicit PlaylistAudioSource(ReleasePool<ReferencedTransportSourceData>& p) : pool(p) {}
+
+  //==============================================================================
+  // audio thread
+  void receive(const Ptr& source, bool isPlaying) {
+    switch (source->role) {
+      case Role::replace: {
+        // nothing is audible while waiting for a seek, so there is nothing to fade out either
+        const bool isAudible = isPlaying && current != nullptr && !seeking;
+        retire(loopPartner);
+        cancelSeek();
+        beginTransition(source, isAudible ? replaceFadeSamples : 0);
+        break;
+      }
+
+      case Role::append:
+        if (current == nullptr) {
+          beginTransition(source, 0);
+        } else if (numQueued < maxQueued) {
+          queue[static_cast<size_t>((firstQueued + numQueued) % maxQueued)] = source;
+          ++numQueued;
+        } else {
+          jassertfalse;  // the queue is full, this one is dropped
+        }
+        break;
+
+      case Role::loopPartner:
+        if (isSameFile(source, current)) {
+          retire(loopPartner);
+          loopPartner = source;
+        }
+        break;
+
+      case Role::seek: {
+        // only the instance for the latest request is any use
+        Ptr incoming = source;
+
+        if (seeking && isSameFile(incoming, current) &&
+            incoming->playbackSource->getNextReadPosition() == requestedSeek) {
+          retire(seekSource);
+          seekSource = std::move(incoming);
+        } else {
+          retire(incoming);
+        }
+        break;
+      }
+    }
+
+    publishState();
+  }
+
+  ReferencedTransportSourceData* getCurrentSource() const { return current.get(); }
+  const Ptr& getCurrent() const { return current; }
+
+  //==============================================================================
+  // any thread
+  void setCrossfadeLength(int numSamples) { crossfadeLength = juce::jmax(0, numSamples); }
+
+  // in playback samples; without a region, setLooping(true) loops the whole file
+  void setLoopRegion(int64 start, int64 end) {
+    loopStart = start;
+    loopEnd = end;
+  }
+
+  void clearLoopRegion() { setLoopRegion(0, 0); }
+
+  // offline renders wait for the read-ahead instead of playing silence, so they are repeatable
+  void setWaitsForReadAhead(bool shouldWait) { waitsForReadAhead = shouldWait; }
+
+  // while the host drives playback, its clock keeps running during a seek
+  void setClockIsExternal(bool isExternal) { clockIsExternal = isExternal; }
+
+  // message thread: where the loader should position a new instance of the current file, or -1
+  int64 takeSeekRequest() { return seekRequest.exchange(-1); }
+
+  // where a loop jump lands, or -1 when nothing loops
+  int64 getLoopStart() const {
+    if (loopEnd.load() > loopStart.load()) return loopStart.load();
+
+    return looping.load() ? 0 : -1;
+  }
+
+  //==============================================================================
+  void prepareToPlay(int samplesPerBlockExpected, double sampleRate) override {
+    scratch.setSize(numPlaybackChannels, juce::jmax(512, samplesPerBlockExpected));
+    initialSeekLead = juce::roundToInt(initialSeekLeadSeconds * sampleRate);
+    maxSeekLead = juce::roundToInt(maxSeekLeadSeconds * sampleRate);
+    seekLead = initialSeekLead;
+  }
+
+  void releaseResources() override {}
+
+  void getNextAudioBlock(const AudioSourceChannelInfo& info) override {
+    if (const auto seek = pendingSeek.exchange(-1); seek >= 0 && current != nullptr)
+      beginSeek(seek);
+
+    int done = 0;
+
+    while (done < info.numSamples) {
+      const auto startSample = info.startSample + done;
+      const auto remaining = info.numSamples - done;
+
+      if (current == nullptr) {
+        info.buffer->clear(startSample, remaining);
+        break;
+      }
+
+      if (seeking) {
+        done += renderWhileSeeking(*info.buffer, startSample, remaining);
+        continue;
+      }
+
+      auto& source = *current->playbackSource;
+      const auto pos = source.getNextReadPosition();
+      const auto length = source.getTotalLength();
+
+      // the loop only applies while the cursor is inside it
+      auto loopFrom = juce::jlimit<int64>(0, length, getLoopStart());
+      auto end = loopEnd.load() > loopStart.load() ? juce::jmin(loopEnd.load(), length) : length;
+      const bool loops = getLoopStart() >= 0 && loopFrom < end && pos < end;
+
+      if (!loops) end = length;
+
+      const bool hasSuccessor = loops || numQueued > 0;
+      // a loop without a partner seeks in place, which has nothing to fade out; fading there
+      // would only cut the end of the loop short
+      const bool canCrossfade = loops ? loopPartner != nullptr : hasSuccessor;
+      // a crossfade never takes more than half of what is left to play
+      const auto span = end - (loops ? loopFrom : 0);
+      const auto fade =
+          canCrossfade ? static_cast<int>(juce::jmin<int64>(crossfadeLength.load(), span / 2)) : 0;
+      const auto handoverAt = end - fade;
+
+      if (hasSuccessor && pos >= handoverAt) {
+        if (loops)
+          jumpToLoopStart(loopFrom, fade);
+        else
+          beginTransition(popQueued(), fade);
+
+        continue;
+      }
+
+      auto numSamples = hasSuccessor
+                            ? static_cast<int>(juce::jmin<int64>(remaining, handoverAt - pos))
+                            : remaining;
+
+      if (fadingOut != nullptr) numSamples = juce::jmin(numSamples, fadeRemaining);
+
+      numSamples = juce::jmin(numSamples, scratch.getNumSamples());
+
+      if (numSamples <= 0) {  // not prepared yet
+        info.buffer->clear(startSample, remaining);
+        break;
+      }
+
+      render(*info.buffer, startSample, numSamples);
+      done += numSamples;
+    }
+
+    publishState();
+  }
+
+  void setNextReadPosition(int64 newPosition) override {
+    pendingSeek = newPosition;
+    position = newPosition;
+  }
+
+  int64 getNextReadPosition() const override { return position.load(); }
+  int64 getTotalLength() const override { return totalLength.load(); }
+  bool isLooping() const override { return looping.load(); }
+  void setLooping(bool shouldLoop) override { looping = shouldLoop; }
+
+ private:
+  static constexpr int numPlaybackChannels = 2;
+  static constexpr int readAheadTimeoutMs = 5000;
+  static constexpr double initialSeekLeadSeconds = 0.25;
+  static constexpr double maxSeekLeadSeconds = 2.0;
+
+  void render(AudioBuffer<float>& buffer, int startSample, int numSamples) {
+    const AudioSourceChannelInfo info(&buffer, startSample, numSamples);
+    waitForReadAhead(*current, info);
+    current->playbackSource->getNextAudioBlock(info);
+
+    if (fadeInRemaining > 0) {
+      const auto numToFade = juce::jmin(numSamples, fadeInRemaining);
+      buffer.applyGainRamp(startSample, numToFade, 1.f - fadeGain(fadeInRemaining),
+                           1.f - fadeGain(fadeInRemaining - numToFade));
+      fadeInRemaining -= numToFade;
+    }
+
+    if (fadingOut == nullptr) return;
+
+    const AudioSourceChannelInfo fadeInfo(&scratch, 0, numSamples);
+    waitForReadAhead(*fadingOut, fadeInfo);
+    fadingOut->playbackSource->getNextAudioBlock(fadeInfo);
+
+    const auto gainOutStart = static_cast<float>(fadeRemaining) / static_cast<float>(fadeLength);
+    const auto gainOutEnd =
+        static_cast<float>(fadeRemaining - numSamples) / static_cast<float>(fadeLength);
+
+    for (int ch = 0; ch < juce::jmin(buffer.getNumChannels(), scratch.getNumChannels()); ++ch) {
+      buffer.applyGainRamp(ch, startSample, numSamples, 1.f - gainOutStart, 1.f - gainOutEnd);
+      buffer.addFromWithRamp(ch, startSample, scratch.getReadPointer(ch), numSamples, gainOutStart,
+                             gainOutEnd);
+    }
+
+    fadeRemaining -= numSamples;
+
+    if (fadeRemaining == 0) finishFade();
+  }
+
+  void waitForReadAhead(ReferencedTransportSourceData& source, const AudioSourceChannelInfo& info) {
+    if (waitsForReadAhead.load() && source.bufferingSource != nullptr)
+      source.bufferingSource->waitForNextAudioBlockReady(info, readAheadTimeoutMs);
+  }
+
+  static float fadeGain(int samplesLeft) {
+    return static_cast<float>(samplesLeft) / static_cast<float>(replaceFadeSamples);
+  }
+
+  void beginSeek(int64 target) {
+    // a seek ends any crossfade in progress
+    finishFade();
+
+    if (!seeking && current->playbackSource->getNextReadPosition() == target) return;
+
+    // offline renders may block, and seeking in place keeps them repeatable
+    if (waitsForReadAhead.load()) {
+      cancelSeek();
+      current->playbackSource->setNextReadPosition(target);
+      return;
+    }
+
+    if (!seeking) seekFadeRemaining = replaceFadeSamples;
+
+    seeking = true;
+    seekClock = target;
+    requestSeekAt(clockIsExternal.load() ? target + seekLead : target);
+  }
+
+  void requestSeekAt(int64 target) {
+    retire(seekSource);
+    requestedSeek = target;
+    seekRequest = target;
+  }
+
+  void cancelSeek() {
+    retire(seekSource);
+    seeking = false;
+    seekFadeRemaining = 0;
+  }
+
+  // returns how many samples it has filled, 0 once playback resumes at the new position
+  int renderWhileSeeking(AudioBuffer<float>& buffer, int startSample, int numSamples) {
+    const auto advanceClock = [this](int n) {
+      if (clockIsExternal.load()) seekClock += n;
+    };
+
+    // the old position fades out first, so the seek does not click
+    if (seekFadeRemaining > 0) {
+      const auto n = juce::jmin(numSamples, seekFadeRemaining, scratch.getNumSamples());
+      current->playbackSource->getNextAudioBlock(AudioSourceChannelInfo(&buffer, startSample, n));
+      buffer.applyGainRamp(startSample, n, fadeGain(seekFadeRemaining),
+                           fadeGain(seekFadeRemaining - n));
+      seekFadeRemaining -= n;
+      advanceClock(n);
+      return n;
+    }
+
+    if (seekSource != nullptr) {
+      const auto startsAt = seekSource->playbackSource->getNextReadPosition();
+      const bool missed =
+          seekClock > startsAt || (!clockIsExternal.load() && seekClock != startsAt);
+
+      if (missed) {
+        // the clock has run past it: ask again, further ahead this time
+        if (clockIsExternal.load()) seekLead = juce::jmin(seekLead * 2, maxSeekLead);
+
+        requestSeekAt(clockIsExternal.load() ? seekClock + seekLead : seekClock);
+      } else if (seekClock == startsAt) {
+        retire(current);
+        current = std::move(seekSource);
+        seekSource = nullptr;
+        seeking = false;
+        fadeInRemaining = replaceFadeSamples;
+        return 0;
+      } else {
+        const auto n = static_cast<int>(juce::jmin<int64>(numSamples, startsAt - seekClock));
+        buffer.clear(startSample, n);
+        advanceClock(n);
+        return n;
+      }
+    }
+
+    buffer.clear(startSample, numSamples);
+    advanceClock(numSamples);
+    return numSamples;
+  }
+
+  void beginTransition(Ptr incoming, int fade) {
+    finishFade();
+    fadeInRemaining = 0;
+
+    Ptr outgoing = std::move(current);
+    current = std::move(incoming);
+
+    if (outgoing != nullptr && fade > 0) {
+      fadingOut = std::move(outgoing);
+      fadeLength = fadeRemaining = fade;
+    } else {
+      park(std::move(outgoing));
+    }
+  }
+
+  void jumpToLoopStart(int64 loopFrom, int fade) {
+    if (loopPartner == nullptr) {
+      // no partner (yet): seek in place, which may leave a gap while the read-ahead refills
+      finishFade();
+      current->playbackSource->setNextReadPosition(loopFrom);
+      return;
+    }
+
+    Ptr partner = std::move(loopPartner);
+    loopPartner = nullptr;
+    partner->playbackSource->setNextReadPosition(loopFrom);
+    beginTransition(std::move(partner), fade);
+  }
+
+  void finishFade() {
+    if (fadingOut != nullptr) {
+      Ptr finished = std::move(fadingOut);
+      fadingOut = nullptr;
+      park(std::move(finished));
+    }
+
+    fadeRemaining = 0;
+  }
+
+  // a source that has stopped playing becomes the next loop partner, or goes to the pool
+  void park(Ptr source) {
+    if (source == nullptr) return;
+
+    const auto loopFrom = getLoopStart();
+
+    if (loopFrom >= 0 && loopPartner == nullptr && source != current &&
+        isSameFile(source, current)) {
+      loopPartner = std::move(source);
+      loopPartner->playbackSource->setNextReadPosition(loopFrom);
+      return;
+    }
+
+    retire(source);
+  }
+
+  // the same file, resampled for the same rate
+  static bool isSameFile(const Ptr& a, const Ptr& b) {
+    return a != nullptr && b != nullptr && a->currentAudioFile == b->currentAudioFile &&
+           juce::approximatelyEqual(a->playbackSampleRate, b->playbackSampleRate);
+  }
+
+  void retire(Ptr& source) {
+    if (source != nullptr) {
+      pool.add(source);
+      source = nullptr;
+    }
+  }
+
+  Ptr popQueued() {
+    auto& slot = queue[static_cast<size_t>(firstQueued)];
+    Ptr next = std::move(slot);
+    slot = nullptr;
+    firstQueued = (firstQueued + 1) % maxQueued;
+    --numQueued;
+    return next;
+  }
+
+  void publishState() {
+    if (seeking)
+      position = seekClock;
+    else
+      position = current != nullptr ? current->playbackSource->getNextReadPosition() : 0;
+
+    totalLength = current != nullptr ? current->playbackSource->getTotalLength() : 0;
+  }
+
+  ReleasePool<ReferencedTransportSourceData>& pool;
+
+  // audio thread only
+  Ptr current, fadingOut, loopPartner, seekSource;
+  std::array<Ptr, maxQueued> queue;
+  int firstQueued = 0, numQueued = 0;
+  int fadeLength = 0, fadeRemaining = 0, fadeInRemaining = 0;
+  AudioBuffer<float> scratch;
+
+  bool seeking = false;
+  int seekFadeRemaining = 0;
+  int64 seekClock = 0, requestedSeek = -1;
+  int initialSeekLead = 0, maxSeekLead = 0, seekLead = 0;
+
+  std::atomic<int64> pendingSeek{-1};
+  std::atomic<int64> seekRequest{-1};
+  std::atomic<bool> clockIsExternal{false};
+  std::atomic<int64> position{0}, totalLength{0};
+  std::atomic<int64> loopStart{0}, loopEnd{0};
+  std::atomic<int> crossfadeLength{0};
+  std::atomic<bool> looping{false};
+  std::atomic<bool> waitsForReadAhead{false};
 };
 
-struct AudioFormatReaderSourceCreator : juce::Thread {
+//==============================================================================
+/*
+  One loader shared by every AudioFilePlayerAudioProcessor in the process.
+  Its worker threads sleep until a job is queued, instead of each player
+  polling its own thread. Background decoding runs on a separate, lower
+  priority pool, so a long decode never holds up opening the next file.
+*/
+struct AudioFileLoaderService {
+  AudioFileLoaderService()
+      : pool(juce::ThreadPoolOptions{}
+                 .withThreadName("Audio file loader")
+                 .withNumberOfThreads(juce::jlimit(1, 4, juce::SystemStats::getNumCpus() / 2))),
+        decodePool(juce::ThreadPoolOptions{}
+                       .withThreadName("Audio file decoder")
+                       .withNumberOfThreads(juce::jlimit(1, 2, juce::SystemStats::getNumCpus() / 4))
+                       .withDesiredThreadPriority(juce::Thread::Priority::low)) {}
+
+  juce::ThreadPool pool;
+  juce::ThreadPool decodePool;
+};
+//==============================================================================
+struct AudioFormatReaderSourceCreator : juce::AudioProcessorValueTreeState::Listener {
   AudioFormatReaderSourceCreator(Fifo<ReferencedTransportSourceData::Ptr>& fifo,
                                  ReleasePool<ReferencedTransportSourceData>& pool,
                                  TimeSliceThread& tst, AudioFormatManager& afm)
-      : juce::Thread("TransportSourceCreator"),
-        transportSourceFifo(fifo),
+      : transportSourceFifo(fifo),
         releasePool(pool),
-        directoryScannerBackgroundThread(tst),
-        formatManager(afm) {
-    startThread();
-  }
-
-  ~AudioFormatReaderSourceCreator() { stopThread(500); }
-
-  void run() override {
-    // create a referenced transport source if there is a new URL to load
-    while (!threadShouldExit()) {
-      if (urlNeedsProcessingFlag.compareAndSetBool(false, true)) {
-        juce::URL audioURL;
-        while (urlFifo.getNumAvailableForReading() > 0) {
-          if (urlFifo.pull(audioURL)) {
-            // create a new referenced transport source for this
-            std::unique_ptr<AudioFormatReader> reader;
-
-            if (audioURL.isLocalFile()) {
-              reader.reset(formatManager.createReaderFor(audioURL.getLocalFile()));
-            } else {
-              auto options = URL::InputStreamOptions(URL::ParameterHandling::inAddress);
-              reader.reset(formatManager.createReaderFor(audioURL.createInputStream(options)));
-            }
-
-            if (reader != nullptr) {
-              using RTS = ReferencedTransportSourceData;
-              RTS::Ptr rts = new ReferencedTransportSourceData();
-
-              rts->audioFileSourceSampleRate = reader->sampleRate;
-
-              rts->currentAudioFileSource.reset(
-                  new AudioFormatReaderSource(reader.release(), true));
-              rts->currentAudioFile = audioURL;
-
-              // add it to the release pool
-              releasePool.add(rts);
-              // add it to the transportSourceFifo
-              transportSourceFifo.push(rts);
-            }
-          }
-        }
+        readAheadThread(tst),
+        formatManager(afm) {}
+
+  ~AudioFormatReaderSourceCreator() override {
+    // queued jobs are dropped, a running one is asked to stop and waited for
+    JobsOwnedBy selector{*this};
+    loader->pool.removeAllJobs(true, 4000, &selector);
+  }
+
+  // the rate files are resampled to, and the block size the streaming sources are prepared for
+  // before they reach the audio thread
+  void setPlaybackSpec(double sampleRate, int samplesPerBlock) {
+    playbackSampleRate = sampleRate;
+    expectedBlockSize = samplesPerBlock;
+  }
+
+  // follows the "Resampler Quality" parameter; applies to the files loaded after the change
+  void parameterChanged(const juce::String&, float newValue) override {
+    resamplerQuality = juce::roundToInt(newValue);
+  }
+
+  // the decode cache is shared by every player in the process, so the last one set wins
+  void setDecodeCacheBudget(size_t bytes) { decodeCache->setMemoryBudget(bytes); }
+
+  // the same goes for the cache of file heads
+  void setHeadCacheBudget(size_t bytes) { headCache->setMemoryBudget(bytes); }
+
+  bool requestTransportForURL(juce::URL url) {
+    // any request still queued or loading for this player is now superseded
+    auto generation = ++latestRequest;
+    loader->pool.addJob(new LoadJob(*this, std::move(url), Role::replace, generation), true);
+    return true;
+  }
+
+  // queues a file to play gaplessly after the current one
+  void appendToPlaylist(juce::URL url) {
+    const juce::ScopedLock sl(appendLock);
+    pendingAppends.add(std::move(url));
+
+    if (!appendJobQueued) {
+      appendJobQueued = true;
+      loader->pool.addJob(new LoadJob(*this, {}, Role::append, 0), true);
+    }
+  }
+
+  // loads a second instance of the current file, positioned at the loop start
+  void requestLoopPartner(juce::URL url, int64 loopStartSample) {
+    loopPartnerStart = loopStartSample;
+    auto generation = ++latestLoopPartnerRequest;
+    loader->pool.addJob(new LoadJob(*this, std::move(url), Role::loopPartner, generation), true);
+  }
+
+  // loads another instance of the current file with its read-ahead already filled at the target
+  void requestSeek(juce::URL url, int64 targetSample) {
+    seekStart = targetSample;
+    auto generation = ++latestSeekRequest;
+    loader->pool.addJob(new LoadJob(*this, std::move(url), Role::seek, generation), true);
+  }
+
+  // called from the processor's timer: sends the loaded seek on once its read-ahead has
+  // reached the target, or once it has waited long enough, so no loader thread sits waiting
+  void publishPendingSeek() {
+    ReferencedTransportSourceData::Ptr ready;
+
+    {
+      const juce::ScopedLock sl(seekLock);
+
+      if (pendingSeek == nullptr) return;
+
+      if (isSuperseded(Role::seek, pendingSeekGeneration)) {
+        // superseded meanwhile: the pool deletes it on the message thread
+        releasePool.add(pendingSeek);
+        pendingSeek = nullptr;
+        return;
       }
 
-      wait(5);
+      AudioBuffer<float> probe(numPlaybackChannels, expectedBlockSize.load());
+      const auto waited = juce::Time::getMillisecondCounter() - pendingSeekSince;
+
+      if (waited < seekReadyTimeoutMs && !pendingSeek->bufferingSource->waitForNextAudioBlockReady(
+                                             AudioSourceChannelInfo(probe), 0))
+        return;
+
+      ready = std::exchange(pendingSeek, nullptr);
     }
+
+    publish(ready);
   }
 
-  bool requestTransportForURL(juce::URL url) {
-    if (urlFifo.push(url)) {
-      urlNeedsProcessingFlag.set(true);
-      return true;
+  // WAV and AIFF can be played straight out of a file mapping; other formats return nullptr
+  std::unique_ptr<MemoryMappedAudioFormatReader> createMemoryMappedReaderFor(const File& file) {
+    if (auto* format = formatManager.findFormatForFileExtension(file.getFileExtension())) {
+      std::unique_ptr<MemoryMappedAudioFormatReader> reader(format->createMemoryMappedReader(file));
+
+      if (reader != nullptr && reader->mapEntireFile()) return reader;
     }
 
-    return false;
+    return nullptr;
   }
 
  private:
-  Fifo<juce::URL> urlFifo;
+  using Role = ReferencedTransportSourceData::Role;
+
+  struct LoadJob : juce::ThreadPoolJob {
+    LoadJob(AudioFormatReaderSourceCreator& o, juce::URL u, Role r, uint32 g)
+        : juce::ThreadPoolJob("Load " + u.getFileName()),
+          owner(o),
+          url(std::move(u)),
+          role(r),
+          generation(g) {}
+
+    JobStatus runJob() override {
+      if (role == Role::append) {
+        // appended files are loaded one after the other, so they reach the playlist in order
+        juce::URL next;
+
+        while (!shouldExit() && owner.takeNextAppend(next))
+          owner.createTransportSource(next, role, generation, *this);
+      } else if (!shouldExit() && !owner.isSuperseded(role, generation)) {
+        owner.createTransportSource(url, role, generation, *this);
+      }
+
+      return jobHasFinished;
+    }
+
+    AudioFormatReaderSourceCreator& owner;
+    const juce::URL url;
+    const Role role;
+    const uint32 generation;
+  };
+
+  struct JobsOwnedBy : juce::ThreadPool::JobSelector {
+    explicit JobsOwnedBy(AudioFormatReaderSourceCreator& o) : owner(o) {}
+
+    bool isJobSuitable(juce::ThreadPoolJob* job) override {
+      auto* loadJob = dynamic_cast<LoadJob*>(job);
+      return loadJob != nullptr && &loadJob->owner == &owner;
+    }
+
+    AudioFormatReaderSourceCreator& owner;
+  };
+
+  bool isSuperseded(Role role, uint32 generation) const {
+    switch (role) {
+      case Role::replace:
+        return generation != latestRequest.load();
+      case Role::loopPartner:
+        return generation != latestLoopPartnerRequest.load();
+      case Role::seek:
+        return generation != latestSeekRequest.load();
+      case Role::append:
+        break;
+    }
+
+    return false;
+  }
+
+  bool takeNextAppend(juce::URL& next) {
+    const juce::ScopedLock sl(appendLock);
+
+    if (pendingAppends.isEmpty()) {
+      appendJobQueued = false;
+      return false;
+    }
+
+    next = pendingAppends.removeAndReturn(0);
+    return true;
+  }
+
+  void createTransportSource(const juce::URL& audioURL, Role role, uint32 generation,
+                             LoadJob& job) {
+    // create a new referenced transport source for this
+    std::unique_ptr<AudioFormatReader> reader;
+    MemoryMappedAudioFormatReader* mappedReader = nullptr;
+
+    if (audioURL.isLocalFile()) {
+      if (auto mapped = createMemoryMappedReaderFor(audioURL.getLocalFile())) {
+        mappedReader = mapped.get();
+        reader = std::move(mapped);
+      } else {
+        reader.reset(formatManager.createReaderFor(audioURL.getLocalFile()));
+      }
+    } else {
+      auto options = URL::InputStreamOptions(URL::ParameterHandling::inAddress);
+      reader.reset(formatManager.createReaderFor(audioURL.createInputStream(options)));
+    }
+
+    // opening the file may take a while, the user could have picked another one meanwhile
+    if (reader == nullptr || job.shouldExit() || isSuperseded(role, generation)) return;
+
+    using RTS = ReferencedTransportSourceData;
+    RTS::Ptr rts = new ReferencedTransportSourceData();
+    rts->role = role;
+
+    rts->audioFileSourceSampleRate = reader->sampleRate;
+    rts->playbackSampleRate = reader->sampleRate;
+
+    rts->currentAudioFileSource.reset(new AudioFormatReaderSource(reader.release(), true));
+    rts->currentAudioFile = audioURL;
+
+    PositionableAudioSource* streamingSource = rts->currentAudioFileSource.get();
+    auto headKey = makeAudioFileCacheKey(audioURL);
+
+    // compressed files are decoded ahead on the loader pool, once for every re-trigger
+    if (mappedReader == nullptr && audioURL.isLocalFile()) {
+      auto file = audioURL.getLocalFile();
+      auto decoded = decodeCache->getOrStartDecoding(
+          headKey, rts->currentAudioFileSource->getTotalLength(),
+          [this, file] {
+            return std::unique_ptr<AudioFormatReader>(formatManager.createReaderFor(file));
+          },
+          loader->decodePool);
+
+      if (decoded != nullptr) {
+        rts->decodedSource = std::make_unique<DecodedAudioSource>(std::move(decoded),
+                                                                  *streamingSource);
+        streamingSource = rts->decodedSource.get();
+      }
+    }
+
+    // convert to the host rate here and in the read-ahead, instead of in the transport
+    const auto hostRate = playbackSampleRate.load();
+
+    if (hostRate > 0 && !juce::approximatelyEqual(hostRate, rts->audioFileSourceSampleRate)) {
+      const auto quality = static_cast<ResamplerQuality>(resamplerQuality.load());
+
+      rts->resamplingSource = std::make_unique<SincResamplingAudioSource>(
+          *streamingSource, rts->audioFileSourceSampleRate, hostRate, quality);
+      rts->playbackSampleRate = hostRate;
+      streamingSource = rts->resamplingSource.get();
+      headKey << "|" << hostRate << "|" << static_cast<int>(quality);
+    }
+
+    // decode the start of the file now, so playback can begin before any read-ahead is done
+    const auto headLength = static_cast<int>(juce::jmin(
+        streamingSource->getTotalLength(),
+        static_cast<int64>(headSeconds * rts->playbackSampleRate)));
+    auto head = headCache->getOrLoad(headKey, *streamingSource, numPlaybackChannels, headLength);
+
+    // a mapped file at the host rate is read directly; anything else goes through a read-ahead,
+    // prepared here rather than by the transport on the audio thread, and without waiting
+    // for the buffer to fill: the head covers that
+    if (mappedReader == nullptr || rts->resamplingSource != nullptr) {
+      rts->bufferingSource = std::make_unique<BufferingAudioSource>(
+          streamingSource, readAheadThread, false, readAheadSamples,
+          numPlaybackChannels, false);
+      rts->bufferingSource->prepareToPlay(expectedBlockSize.load(), rts->playbackSampleRate);
+      streamingSource = rts->bufferingSource.get();
+    }
+
+    rts->playbackSource =
+        std::make_unique<HeadCachedAudioSource>(std::move(head), *streamingSource);
+
+    // follows the playback source, whose position is atomic, rather than the reader source,
+    // which the audio thread moves without any synchronisation when it reads the file directly
+    if (mappedReader != nullptr) {
+      rts->prefetcher = std::make_unique<MappedFilePrefetcher>(
+          *mappedReader, *rts->playbackSource, rts->playbackSampleRate);
+      rts->prefetchThread = &readAheadThread;
+      readAheadThread.addTimeSliceClient(rts->prefetcher.get());
+    }
+
+    // start the read-ahead at the loop start, where the partner will be jumped to
+    if (role == Role::loopPartner) rts->playbackSource->setNextReadPosition(loopPartnerStart);
+
+    if (role == Role::seek) {
+      rts->playbackSource->setNextReadPosition(seekStart);
+
+      // the playlist stays silent until this arrives, so it is only sent once it can play;
+      // the timer checks on the read-ahead rather than this thread waiting for it
+      if (rts->bufferingSource != nullptr) {
+        const juce::ScopedLock sl(seekLock);
+
+        if (pendingSeek != nullptr) releasePool.add(pendingSeek);
+
+        pendingSeek = rts;
+        pendingSeekGeneration = generation;
+        pendingSeekSince = juce::Time::getMillisecondCounter();
+        return;
+      }
+    }
+
+    publish(rts);
+  }
+
+  void publish(const ReferencedTransportSourceData::Ptr& rts) {
+    // several jobs of this player can finish at once, but the transport fifo takes one producer
+    const juce::ScopedLock sl(publishLock);
+
+    // add it to the release pool
+    releasePool.add(rts);
+    // add it to the transportSourceFifo
+    transportSourceFifo.push(rts);
+  }
+
+  static constexpr double headSeconds = 2.0;
+  static constexpr int readAheadSamples = 32768;
+  static constexpr int numPlaybackChannels = 2;
+  static constexpr juce::uint32 seekReadyTimeoutMs = 2000;
+
+  juce::SharedResourcePointer<AudioFileLoaderService> loader;
+  juce::SharedResourcePointer<AudioFileHeadCache> headCache;
+  juce::SharedResourcePointer<DecodedAudioCache> decodeCache;
+
   Fifo<ReferencedTransportSourceData::Ptr>& transportSourceFifo;
   ReleasePool<ReferencedTransportSourceData>& releasePool;
 
-  TimeSliceThread& directoryScannerBackgroundThread;
+  TimeSliceThread& readAheadThread;
+
+  std::atomic<uint32> latestRequest{0};
+  std::atomic<uint32> latestLoopPartnerRequest{0};
+  std::atomic<int64> loopPartnerStart{0};
+  std::atomic<uint32> latestSeekRequest{0};
+  std::atomic<int64> seekStart{0};
+  juce::CriticalSection seekLock;
+  ReferencedTransportSourceData::Ptr pendingSeek;
+  uint32 pendingSeekGeneration = 0;
+  uint32 pendingSeekSince = 0;
+  std::atomic<int> expectedBlockSize{512};
+  std::atomic<double> playbackSampleRate{0};
+  std::atomic<int> resamplerQuality{static_cast<int>(ResamplerQuality::normal)};
+  juce::CriticalSection publishLock;
 
-  juce::Atomic<bool> urlNeedsProcessingFlag{false};
+  juce::CriticalSection appendLock;
+  juce::Array<juce::URL> pendingAppends;
+  bool appendJobQueued = false;
 
   AudioFormatManager& formatManager;
 };
 /**
  */
-class AudioFilePlayerAudioProcessor : public juce::AudioProcessor {
+class AudioFilePlayerAudioProcessor : public juce::AudioProcessor, private juce::Timer {
  public:
   //==============================================================================
   AudioFilePlayerAudioProcessor();
@@ -215,6 +1110,7 @@ class AudioFilePlayerAudioProcessor : public juce::AudioProcessor {
 #endif
 
   void processBlock(juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
+  void setNonRealtime(bool isNonRealtime) noexcept override;
 
   //==============================================================================
   juce::AudioProcessorEditor* createEditor() override;
@@ -242,17 +1138,27 @@ class AudioFilePlayerAudioProcessor : public juce::AudioProcessor {
   using APVTS = juce::AudioProcessorValueTreeState;
   static APVTS::ParameterLayout createParameterLayout();
   APVTS apvts{*this, nullptr, "Properties", createParameterLayout()};
+  std::atomic<float>* syncToHost =
+      apvts.getRawParameterValue(Params::GetParamNames().at(Params::Names::Sync_To_Host));
+  std::atomic<float>* crossfadeSeconds =
+      apvts.getRawParameterValue(Params::GetParamNames().at(Params::Names::Crossfade));
+  std::atomic<float>* loopStartSeconds =
+      apvts.getRawParameterValue(Params::GetParamNames().at(Params::Names::Loop_Start));
+  std::atomic<float>* loopEndSeconds =
+      apvts.getRawParameterValue(Params::GetParamNames().at(Params::Names::Loop_End));
   juce::Atomic<bool> transportIsPlaying{false};
 
-  TimeSliceThread directoryScannerBackgroundThread{"audio file preview"};
+  // playback read-ahead only; the file browser lists directories on its own threads
+  TimeSliceThread readAheadThread{"audio file read-ahead"};
 
   Fifo<ReferencedTransportSourceData::Ptr> fifo;
   ReleasePool<ReferencedTransportSourceData> pool;
+  PlaylistAudioSource playlist{pool};
 
   AudioTransportSource transportSource;
   AudioFormatManager formatManager;
   AudioFormatReaderSourceCreator transportSourceCreator{
-      fifo, pool, directoryScannerBackgroundThread, formatManager};
+      fifo, pool, readAheadThread, formatManager};
 
   ReferencedTransportSourceData::Ptr activeSource;
 
@@ -265,7 +1171,28 @@ class AudioFilePlayerAudioProcessor : public juce::AudioProcessor {
   }
   juce::Atomic<bool> sourceHasChanged{false};
 
+  //==============================================================================
+  void appendToPlaylist(const juce::URL& url);
+
  private:
+  // the audio thread reports every new current source here, for the message thread
+  Fifo<ReferencedTransportSourceData::Ptr> nowPlayingFifo;
+  juce::URL nowPlaying, loopPartnerRequestedFor;
+  int64 loopPartnerRequestedAt = -1;
+  int decodeCacheSizeIndex = -1, headCacheSizeIndex = -1;
+
+  void timerCallback() override;
+  void updateLoopPartner();
+  void updateCacheBudgets();
+
+  // audio thread: hands the crossfade and loop parameters to the playlist, in playback samples
+  void updatePlaylistSettings();
+
+  // audio thread: seeks the playlist wherever the host jumps, returns whether the host is playing
+  bool followHostTransport(int numSamples);
+  bool hostWasPlaying = false;
+  int64 expectedHostSample = -1;
+
   //==============================================================================
   JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AudioFilePlayerAudioProcessor)
 };
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <juce_events/juce_events.h>
+
+#include <array>
+#include <atomic>
+#include <unordered_map>
+
+//==============================================================================
+/*
+  Deferred reclamation for reference-counted objects shared with the audio thread.
+
+  add() can be called from any thread, including the audio thread. It takes an
+  extra reference and parks the pointer in a free slot of a fixed array, so it
+  never allocates, never blocks and never deletes.
+
+  The message thread collects the slots and drops its reference to an object
+  once
+    - nothing but the pool refers to it any more, and
+    - the audio thread has left every ScopedReader section it was in when the
+      object was collected (epoch based), so raw pointers it took from the
+      object inside such a section are never left dangling.
+
+  Objects handed to the pool are therefore always deleted on the message thread.
+*/
+template <typename ReferenceCountedType, size_t Capacity = 512>
+struct ReleasePool : juce::Timer {
+  using Ptr = typename ReferenceCountedType::Ptr;
+
+  static constexpr int collectionIntervalMs = 100;
+
+  ReleasePool() { startTimer(collectionIntervalMs); }
+
+  ~ReleasePool() override {
+    stopTimer();
+
+    // whatever is left gets released here, together with the retired list
+    for (auto& slot : slots)
+      if (auto* object = slot.exchange(nullptr)) adopt(object);
+  }
+
+  void add(const Ptr& ptr) { add(ptr.get()); }
+
+  void add(ReferenceCountedType* object) {
+    if (object == nullptr) return;
+
+    object->incReferenceCount();
+
+    auto start = nextSlot.fetch_add(1, std::memory_order_relaxed);
+
+    for (size_t i = 0; i < Capacity; ++i) {
+      ReferenceCountedType* expected = nullptr;
+
+      if (slots[(start + i) % Capacity].compare_exchange_strong(expected, object)) return;
+    }
+
+    // every slot is taken: keep the reference forever rather than risk deleting on this thread
+    overflows.fetch_add(1);
+    jassertfalse;
+  }
+
+  //==============================================================================
+  /*
+    Put one of these around every block of audio-thread code that uses objects
+    handed to the pool, e.g. the whole of processBlock().
+  */
+  struct ScopedReader {
+    explicit ScopedReader(ReleasePool& p) : pool(p) {
+      pool.readerEpoch.store(pool.globalEpoch.load());
+    }
+
+    ~ScopedReader() { pool.readerEpoch.store(0); }
+
+    ReleasePool& pool;
+
+    JUCE_DECLARE_NON_COPYABLE(ScopedReader)
+  };
+
+  //==============================================================================
+  // Called by the timer; only ever call it from the message thread.
+  void collect() {
+    for (auto& slot : slots)
+      if (auto* object = slot.exchange(nullptr)) adopt(object);
+
+    // anything collected above is tagged with the epoch before this increment
+    globalEpoch.fetch_add(1);
+    const auto reader = readerEpoch.load();
+
+    for (auto it = retired.begin(); it != retired.end();) {
+      const bool readerHasMovedOn = reader == 0 || reader > it->second.epoch;
+
+      if (readerHasMovedOn && it->second.ptr->getReferenceCount() <= 1)
+        it = retired.erase(it);
+      else
+        ++it;
+    }
+  }
+
+  void timerCallback() override { collect(); }
+
+  size_t getNumRetired() const { return retired.size(); }
+  int getNumOverflows() const { return overflows.load(); }
+
+ private:
+  struct Retired {
+    Ptr ptr;
+    juce::uint64 epoch = 0;
+  };
+
+  std::array<std::atomic<ReferenceCountedType*>, Capacity> slots{};
+  std::atomic<size_t> nextSlot{0};
+  std::atomic<int> overflows{0};
+
+  std::atomic<juce::uint64> globalEpoch{1};
+  std::atomic<juce::uint64> readerEpoch{0};  // 0 while the audio thread is outside a section
+
+  // only touched on the message thread; duplicates are merged here
+  std::unordered_map<ReferenceCountedType*, Retired> retired;
+
+  void adopt(ReferenceCountedType* object) {
+    auto& entry = retired[object];
+
+    if (entry.ptr == nullptr) entry.ptr = object;
+
+    // hand the reference taken in add() over to entry.ptr, which keeps the object alive
+    object->decReferenceCountWithoutDeleting();
+
+    entry.epoch = globalEpoch.load();
+  }
+};
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <juce_dsp/juce_dsp.h>
+
+#include <vector>
+
+enum class ResamplerQuality { fast, normal, best };
+
+//==============================================================================
+/*
+  Converts a positionable source to another sample rate with a polyphase
+  windowed-sinc filter, interpolating linearly between precomputed phases.
+
+  Meant to sit underneath a BufferingAudioSource, so the filtering runs on the
+  read-ahead thread instead of inside the audio callback. Positions are in
+  output samples. Always produces two channels; they are kept interleaved so
+  one SIMD register holds several taps of both.
+*/
+class SincResamplingAudioSource : public juce::PositionableAudioSource {
+ public:
+  SincResamplingAudioSource(juce::PositionableAudioSource& input, double inputSampleRate,
+                            double outputSampleRate, ResamplerQuality quality);
+
+  void prepareToPlay(int samplesPerBlockExpected, double sampleRate) override;
+  void releaseResources() override;
+  void getNextAudioBlock(const juce::AudioSourceChannelInfo& info) override;
+
+  void setNextReadPosition(juce::int64 newPosition) override;
+  juce::int64 getNextReadPosition() const override;
+  juce::int64 getTotalLength() const override;
+  bool isLooping() const override;
+  void setLooping(bool shouldLoop) override;
+
+ private:
+#if JUCE_USE_SIMD
+  using Vec = juce::dsp::SIMDRegister<float>;
+  static constexpr int floatsPerVec = static_cast<int>(Vec::SIMDNumElements);
+#else
+  static constexpr int floatsPerVec = 2;
+#endif
+  // stereo frames per register: a window can start on any of these offsets
+  static constexpr int framesPerVec = floatsPerVec / 2;
+  static constexpr int numPhases = 256;
+  static constexpr int inputChunkSize = 1024;
+
+  void buildPhaseTable(double cutoff, double beta);
+  void resetHistory();
+  void pullInput(juce::int64 firstFrameNeeded, juce::int64 endFrameNeeded);
+  void interpolate(double inputTime, float& left, float& right) const;
+
+  juce::PositionableAudioSource& input;
+  const double inputRate, ratio;
+  const int numTaps, halfTaps;
+  int rowSize = 0;  // floats per table row, a whole number of registers
+
+  std::vector<float> tableStorage, historyStorage;
+  float* table = nullptr;
+  float* history = nullptr;  // interleaved stereo frames
+  int historyCapacity = 0;
+
+  juce::int64 historyStart = 0;  // input frame held in history[0]
+  int historyFrames = 0;
+  juce::int64 position = 0;
+  bool needsReset = true;
+
+  juce::AudioBuffer<float> inputBlock;
+
+  JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SincResamplingAudioSource)
+};
@@ -0,0 +1,396 @@
+#pragma once
+
+#include <juce_audio_formats/juce_audio_formats.h>
+#include <juce_events/juce_events.h>
+
+#include "DecodedAudioCache.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <list>
+#include <memory>
+#include <vector>
+
+//==============================================================================
+/*
+  Min/max overview of a file at several resolutions. Level 0 has one bin per
+  baseBinSize samples and every level above merges levelFactor bins of the one
+  below, so any zoom can be drawn from a level with about one bin per pixel.
+  Values are stored as int8, two bytes per bin and channel, which keeps even a
+  multi-hour recording in the low megabytes.
+*/
+struct WaveformPyramid {
+  static constexpr int baseBinSize = 512;
+  static constexpr int levelFactor = 4;
+  static constexpr int minBinsPerLevel = 64;
+
+  struct Level {
+    int samplesPerBin = 0;
+    int numBins = 0;
+    std::vector<std::vector<juce::int8>> channels;  // min and max of each bin, interleaved
+  };
+
+  int numChannels = 0;
+  double sampleRate = 0;
+  juce::int64 lengthInSamples = 0;
+  std::vector<Level> levels;
+
+  double getLengthInSeconds() const {
+    return sampleRate > 0 ? static_cast<double>(lengthInSamples) / sampleRate : 0.0;
+  }
+
+  size_t getSizeInBytes() const {
+    size_t bytes = 0;
+
+    for (auto& level : levels) bytes += static_cast<size_t>(2 * level.numBins * numChannels);
+
+    return bytes;
+  }
+
+  // the coarsest level that still has at least one bin per pixel
+  const Level& getLevelFor(double samplesPerPixel) const {
+    jassert(!levels.empty());
+    size_t best = 0;
+
+    for (size_t i = 1; i < levels.size(); ++i)
+      if (levels[i].samplesPerBin <= samplesPerPixel) best = i;
+
+    return levels[best];
+  }
+
+  // min and max between two sample positions, in the range -1 to 1
+  juce::Range<float> getMinMax(const Level& level, int channel, juce::int64 start,
+                               juce::int64 end) const {
+    const auto firstBin = static_cast<int>(juce::jlimit<juce::int64>(
+        0, level.numBins, start / level.samplesPerBin));
+
+    if (firstBin >= level.numBins) return {};
+
+    const auto endBin = static_cast<int>(juce::jlimit<juce::int64>(
+        firstBin + 1, level.numBins, (end + level.samplesPerBin - 1) / level.samplesPerBin));
+
+    const auto& data = level.channels[static_cast<size_t>(channel)];
+    int lo = 127, hi = -127;
+
+    for (auto bin = firstBin; bin < endBin; ++bin) {
+      lo = juce::jmin(lo, static_cast<int>(data[static_cast<size_t>(2 * bin)]));
+      hi = juce::jmax(hi, static_cast<int>(data[static_cast<size_t>(2 * bin + 1)]));
+    }
+
+    return {static_cast<float>(lo) / 127.0f, static_cast<float>(hi) / 127.0f};
+  }
+
+  //==============================================================================
+  // reads the whole file once; returns nullptr if shouldStop() says so on the way
+  static std::unique_ptr<WaveformPyramid> build(juce::AudioFormatReader& reader,
+                                                const std::function<bool()>& shouldStop) {
+    auto pyramid = std::make_unique<WaveformPyramid>();
+    pyramid->numChannels = static_cast<int>(juce::jmax(1u, reader.numChannels));
+    pyramid->sampleRate = reader.sampleRate;
+    pyramid->lengthInSamples = reader.lengthInSamples;
+
+    Level base;
+    base.samplesPerBin = baseBinSize;
+    base.numBins = static_cast<int>((reader.lengthInSamples + baseBinSize - 1) / baseBinSize);
+    base.channels.assign(static_cast<size_t>(pyramid->numChannels),
+                         std::vector<juce::int8>(static_cast<size_t>(2 * base.numBins)));
+
+    constexpr int binsPerRead = 256;
+    juce::AudioBuffer<float> block(pyramid->numChannels, binsPerRead * baseBinSize);
+
+    for (int firstBin = 0; firstBin < base.numBins; firstBin += binsPerRead) {
+      if (shouldStop()) return nullptr;
+
+      const auto start = static_cast<juce::int64>(firstBin) * baseBinSize;
+      const auto numSamples = static_cast<int>(
+          juce::jmin<juce::int64>(block.getNumSamples(), reader.lengthInSamples - start));
+
+      reader.read(&block, 0, numSamples, start, true, true);
+
+      for (int ch = 0; ch < pyramid->numChannels; ++ch) {
+        auto& data = base.channels[static_cast<size_t>(ch)];
+
+        for (int offset = 0; offset < numSamples; offset += baseBinSize) {
+          const auto range = juce::FloatVectorOperations::findMinAndMax(
+              block.getReadPointer(ch, offset), juce::jmin(baseBinSize, numSamples - offset));
+          const auto bin = static_cast<size_t>(firstBin + offset / baseBinSize);
+
+          data[2 * bin] = toInt8(std::floor(range.getStart() * 127.0f));
+          data[2 * bin + 1] = toInt8(std::ceil(range.getEnd() * 127.0f));
+        }
+      }
+    }
+
+    pyramid->levels.push_back(std::move(base));
+
+    while (pyramid->levels.back().numBins > minBinsPerLevel)
+      pyramid->levels.push_back(merge(pyramid->levels.back()));
+
+    return pyramid;
+  }
+
+  //==============================================================================
+  void writeTo(juce::OutputStream& out, const juce::String& key) const {
+    out.writeInt(magic);
+    out.writeInt(version);
+    out.writeString(key);
+    out.writeInt(numChannels);
+    out.writeDouble(sampleRate);
+    out.writeInt64(lengthInSamples);
+    out.writeInt(static_cast<int>(levels.size()));
+
+    for (auto& level : levels) {
+      out.writeInt(level.samplesPerBin);
+      out.writeInt(level.numBins);
+
+      for (auto& data : level.channels) out.write(data.data(), data.size());
+    }
+  }
+
+  // returns nullptr unless the stream holds a complete overview stored under this key
+  static std::unique_ptr<WaveformPyramid> readFrom(juce::InputStream& in,
+                                                   const juce::String& key) {
+    if (in.readInt() != magic || in.readInt() != version || in.readString() != key)
+      return nullptr;
+
+    auto pyramid = std::make_unique<WaveformPyramid>();
+    pyramid->numChannels = in.readInt();
+    pyramid->sampleRate = in.readDouble();
+    pyramid->lengthInSamples = in.readInt64();
+    const auto numLevels = in.readInt();
+
+    if (pyramid->numChannels <= 0 || pyramid->numChannels > 64 || numLevels <= 0 ||
+        numLevels > 32)
+      return nullptr;
+
+    for (int i = 0; i < numLevels; ++i) {
+      Level level;
+      level.samplesPerBin = in.readInt();
+      level.numBins = in.readInt();
+
+      // checked in 64 bits before anything is allocated, so a corrupt count can't overflow
+      if (level.samplesPerBin <= 0 || level.numBins < 0 ||
+          static_cast<juce::int64>(level.numBins) * 2 * pyramid->numChannels >
+              in.getNumBytesRemaining())
+        return nullptr;
+
+      const auto bytes = static_cast<size_t>(level.numBins) * 2;
+
+      level.channels.assign(static_cast<size_t>(pyramid->numChannels),
+                            std::vector<juce::int8>(bytes));
+
+      for (auto& data : level.channels)
+        if (in.read(data.data(), static_cast<int>(bytes)) != static_cast<int>(bytes))
+          return nullptr;
+
+      pyramid->levels.push_back(std::move(level));
+    }
+
+    return pyramid;
+  }
+
+ private:
+  static constexpr int magic = 0x59504657;  // "WFPY"
+  static constexpr int version = 1;
+
+  static juce::int8 toInt8(float v) {
+    return static_cast<juce::int8>(juce::jlimit(-127, 127, static_cast<int>(v)));
+  }
+
+  static Level merge(const Level& below) {
+    Level level;
+    level.samplesPerBin = below.samplesPerBin * levelFactor;
+    level.numBins = (below.numBins + levelFactor - 1) / levelFactor;
+    level.channels.reserve(below.channels.size());
+
+    for (auto& source : below.channels) {
+      std::vector<juce::int8> data(static_cast<size_t>(2 * level.numBins));
+
+      for (int bin = 0; bin < level.numBins; ++bin) {
+        juce::int8 lo = 127, hi = -127;
+
+        for (int i = bin * levelFactor; i < juce::jmin(below.numBins, (bin + 1) * levelFactor);
+             ++i) {
+          lo = juce::jmin(lo, source[static_cast<size_t>(2 * i)]);
+          hi = juce::jmax(hi, source[static_cast<size_t>(2 * i + 1)]);
+        }
+
+        data[static_cast<size_t>(2 * bin)] = lo;
+        data[static_cast<size_t>(2 * bin + 1)] = hi;
+      }
+
+      level.channels.push_back(std::move(data));
+    }
+
+    return level;
+  }
+};
+//==============================================================================
+/*
+  Waveform overviews kept on disk, keyed by path, size and modification time,
+  so a file that has been seen before shows up without being read again. The
+  few most recent ones are also kept in memory. Files are read and overviews
+  built on a background thread; each request supersedes the previous one.
+*/
+class WaveformThumbnailCache {
+ public:
+  using Pyramid = std::shared_ptr<const WaveformPyramid>;
+  using Callback = std::function<void(Pyramid)>;
+
+  static constexpr int numKeptInMemory = 5;
+  static constexpr juce::int64 defaultDiskBudgetInBytes = 256 * 1024 * 1024;
+
+  explicit WaveformThumbnailCache(juce::File dir = getDefaultDirectory())
+      : directory(std::move(dir)) {}
+
+  ~WaveformThumbnailCache() { pool.removeAllJobs(true, 4000); }
+
+  static juce::File getDefaultDirectory() {
+    return juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+        .getChildFile("play_audio")
+        .getChildFile("Thumbnails");
+  }
+
+  /*
+    Looks the overview up in memory, then on disk, and builds it from the file
+    as a last resort. onReady is called on the message thread, with nullptr if
+    the file could not be read. A request superseded while its result is on
+    the way may still be answered, so callers should check it is still wanted.
+  */
+  void request(const juce::URL& url, juce::AudioFormatManager& formatManager, Callback onReady) {
+    const auto key = makeAudioFileCacheKey(url);
+
+    // anything still queued or building is for a file nobody is looking at any more
+    pool.removeAllJobs(true, 0);
+
+    if (auto found = findInMemory(key)) {
+      onReady(std::move(found));
+      return;
+    }
+
+    pool.addJob(
+        [this, url, key, &formatManager, onReady = std::move(onReady)] {
+          auto* job = juce::ThreadPoolJob::getCurrentThreadPoolJob();
+          auto shouldStop = [job] { return job != nullptr && job->shouldExit(); };
+
+          Pyramid pyramid = url.isLocalFile() ? loadFromDisk(key) : nullptr;
+
+          if (pyramid == nullptr) {
+            pyramid = buildFromFile(url, formatManager, shouldStop);
+
+            if (pyramid != nullptr && url.isLocalFile()) saveToDisk(key, *pyramid);
+          }
+
+          if (shouldStop()) return;
+
+          if (pyramid != nullptr) keepInMemory(key, pyramid);
+
+          juce::MessageManager::callAsync([onReady, pyramid] { onReady(pyramid); });
+        });
+  }
+
+ private:
+  juce::File getCacheFileFor(const juce::String& key) const {
+    return directory.getChildFile(juce::String::toHexString(key.hashCode64()) + ".wfpy");
+  }
+
+  Pyramid loadFromDisk(const juce::String& key) const {
+    const auto file = getCacheFileFor(key);
+    juce::FileInputStream in(file);
+
+    if (!in.openedOk()) return nullptr;
+
+    auto pyramid = WaveformPyramid::readFrom(in, key);
+
+    // recently used files are the last to be pruned
+    if (pyramid != nullptr) file.setLastModificationTime(juce::Time::getCurrentTime());
+
+    return pyramid;
+  }
+
+  static Pyramid buildFromFile(const juce::URL& url, juce::AudioFormatManager& formatManager,
+                               const std::function<bool()>& shouldStop) {
+    std::unique_ptr<juce::AudioFormatReader> reader;
+
+    if (url.isLocalFile()) {
+      reader.reset(formatManager.createReaderFor(url.getLocalFile()));
+    } else {
+      auto options = juce::URL::InputStreamOptions(juce::URL::ParameterHandling::inAddress);
+      reader.reset(formatManager.createReaderFor(url.createInputStream(options)));
+    }
+
+    if (reader == nullptr) return nullptr;
+
+    return WaveformPyramid::build(*reader, shouldStop);
+  }
+
+  void saveToDisk(const juce::String& key, const WaveformPyramid& pyramid) const {
+    if (!directory.createDirectory()) return;
+
+    // written aside and moved into place, so a half-written file is never read back
+    const auto target = getCacheFileFor(key);
+    juce::TemporaryFile temp(target);
+
+    if (auto out = temp.getFile().createOutputStream()) {
+      pyramid.writeTo(*out, key);
+      out->flush();
+
+      if (out->getStatus().wasOk()) {
+        out.reset();
+        temp.overwriteTargetFileWithTemporary();
+      }
+    }
+
+    pruneDisk();
+  }
+
+  // drops the least recently used overviews once the directory grows past its budget
+  void pruneDisk() const {
+    auto files = directory.findChildFiles(juce::File::findFiles, false, "*.wfpy");
+    juce::int64 total = 0;
+
+    for (auto& f : files) total += f.getSize();
+
+    if (total <= defaultDiskBudgetInBytes) return;
+
+    std::sort(files.begin(), files.end(), [](const juce::File& a, const juce::File& b) {
+      return a.getLastModificationTime() < b.getLastModificationTime();
+    });
+
+    for (auto& f : files) {
+      if (total <= defaultDiskBudgetInBytes) break;
+
+      total -= f.getSize();
+      f.deleteFile();
+    }
+  }
+
+  Pyramid findInMemory(const juce::String& key) {
+    const juce::ScopedLock sl(memoryLock);
+
+    for (auto it = recent.begin(); it != recent.end(); ++it) {
+      if (it->first == key) {
+        recent.splice(recent.begin(), recent, it);
+        return recent.front().second;
+      }
+    }
+
+    return nullptr;
+  }
+
+  void keepInMemory(const juce::String& key, Pyramid pyramid) {
+    const juce::ScopedLock sl(memoryLock);
+    recent.emplace_front(key, std::move(pyramid));
+
+    while (recent.size() > numKeptInMemory) recent.pop_back();
+  }
+
+  const juce::File directory;
+
+  juce::CriticalSection memoryLock;
+  std::list<std::pair<juce::String, Pyramid>> recent;
+
+  juce::ThreadPool pool{juce::ThreadPoolOptions{}.withThreadName("Waveform thumbnails")
+                            .withNumberOfThreads(1)};
+};
@@ -0,0 +1,149 @@
+#include "AudioFileBrowser.h"
+
+//==============================================================================
+class AudioFileBrowser::FileItem : public juce::TreeViewItem
+{
+public:
+    FileItem (AudioFileBrowser& o, const juce::File& f, bool isDir)
+        : file (f), isDirectory (isDir), owner (o)
+    {
+    }
+
+    ~FileItem() override
+    {
+        cancelScan();
+    }
+
+    const juce::File file;
+    const bool isDirectory;
+
+    bool mightContainSubItems() override            { return isDirectory; }
+    juce::String getUniqueName() const override     { return file.getFullPathName(); }
+    int getItemHeight() const override              { return 22; }
+
+    void itemOpennessChanged (bool isNowOpen) override
+    {
+        // a folder is listed once, the first time it is opened
+        if (isNowOpen && isDirectory && scanToken == nullptr)
+        {
+            scanToken = owner.scanner->scan (file, [this] (const DirectoryScanner::Listing& batch, bool)
+            {
+                for (auto& entry : batch)
+                    addSubItemSorted (order, new FileItem (owner, entry.file, entry.isDirectory));
+            });
+        }
+    }
+
+    void itemSelectionChanged (bool isNowSelected) override
+    {
+        if (isNowSelected)
+            owner.listeners.call ([] (juce::FileBrowserListener& l) { l.selectionChanged(); });
+    }
+
+    void itemClicked (const juce::MouseEvent& e) override
+    {
+        owner.listeners.call ([this, &e] (juce::FileBrowserListener& l) { l.fileClicked (file, e); });
+    }
+
+    void itemDoubleClicked (const juce::MouseEvent&) override
+    {
+        if (isDirectory)
+            setOpen (! isOpen());
+        else
+            owner.listeners.call ([this] (juce::FileBrowserListener& l) { l.fileDoubleClicked (file); });
+    }
+
+    void paintItem (juce::Graphics& g, int width, int height) override
+    {
+        auto& lf = owner.getLookAndFeel();
+
+        if (isSelected())
+            g.fillAll (owner.findColour (juce::DirectoryContentsDisplayComponent::highlightColourId));
+
+        if (auto* icon = isDirectory ? lf.getDefaultFolderImage() : lf.getDefaultDocumentFileImage())
+            icon->drawWithin (g, { 2.0f, 2.0f, (float) height - 4.0f, (float) height - 4.0f },
+                              juce::RectanglePlacement::centred, 1.0f);
+
+        g.setColour (owner.findColour (isSelected() ? juce::DirectoryContentsDisplayComponent::highlightedTextColourId
+                                                    : juce::DirectoryContentsDisplayComponent::textColourId));
+        g.setFont ((float) height * 0.7f);
+        g.drawFittedText (file.getFileName(), height + 4, 0, width - height - 6, height,
+                          juce::Justification::centredLeft, 1);
+    }
+
+    void cancelScan()
+    {
+        if (scanToken != nullptr)
+            *scanToken = true;
+    }
+
+private:
+    // folders first, then by name, the way FileTreeComponent sorts them
+    struct Order
+    {
+        static int compareElements (juce::TreeViewItem* a, juce::TreeViewItem* b)
+        {
+            auto* first  = static_cast<FileItem*> (a);
+            auto* second = static_cast<FileItem*> (b);
+
+            if (first->isDirectory != second->isDirectory)
+                return first->isDirectory ? -1 : 1;
+
+            return first->file.getFileName().compareNatural (second->file.getFileName());
+        }
+    };
+
+    AudioFileBrowser& owner;
+    DirectoryScanner::Token scanToken;
+    Order order;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (FileItem)
+};
+
+//==============================================================================
+AudioFileBrowser::AudioFileBrowser()
+{
+    setRootItemVisible (false);
+    setDefaultOpenness (false);
+}
+
+AudioFileBrowser::~AudioFileBrowser()
+{
+    setRootItem (nullptr);
+}
+
+void AudioFileBrowser::setFileWildcards (const juce::String& wildcards)
+{
+    scanner->setFileWildcards (wildcards);
+
+    if (rootItem != nullptr)
+        setRoot (rootItem->file);
+}
+
+void AudioFileBrowser::setRoot (const juce::File& directory)
+{
+    setRootItem (nullptr);
+    rootItem = std::make_unique<FileItem> (*this, directory, true);
+    setRootItem (rootItem.get());
+    rootItem->setOpen (true);
+
+    listeners.call ([&directory] (juce::FileBrowserListener& l) { l.browserRootChanged (directory); });
+}
+
+juce::File AudioFileBrowser::getSelectedFile() const
+{
+    if (auto* item = dynamic_cast<FileItem*> (getSelectedItem (0)))
+        return item->file;
+
+    return {};
+}
+
+void AudioFileBrowser::addListener (juce::FileBrowserListener* listener)
+{
+    listeners.add (listener);
+}
+
+void AudioFileBrowser::removeListener (juce::FileBrowserListener* listener)
+{
+    listeners.remove (listener);
+}
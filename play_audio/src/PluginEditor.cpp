@@ -9,15 +9,13 @@
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
 
-DemoThumbnailComp::DemoThumbnailComp (AudioFormatManager& formatManager,
+DemoThumbnailComp::DemoThumbnailComp (AudioFormatManager& afm,
                                       Slider& slider,
                                       AudioTransportSource& source)
 : transportSource (source),
 zoomSlider (slider),
-thumbnail (512, formatManager, thumbnailCache)
+formatManager (afm)
 {
-    thumbnail.addChangeListener (this);
-    
     addAndMakeVisible (scrollbar);
     scrollbar.setRangeLimits (visibleRange);
     scrollbar.setAutoHide (false);
@@ -30,44 +28,38 @@ thumbnail (512, formatManager, thumbnailCache)
 DemoThumbnailComp::~DemoThumbnailComp()
 {
     scrollbar.removeListener (this);
-    thumbnail.removeChangeListener (this);
 }
 
 void DemoThumbnailComp::setURL (const URL& url)
 {
-    InputSource* inputSource = nullptr;
-    
-#if ! JUCE_IOS
-    if (url.isLocalFile())
-    {
-        inputSource = new FileInputSource (url.getLocalFile());
-    }
-    else
-#endif
-    {
-        if (inputSource == nullptr)
-            inputSource = new URLInputSource (url);
-    }
+    waveformURL = url;
+    waveform = nullptr;
+    repaint();
     
-    if (inputSource != nullptr)
+    // files seen before come back from the on-disk cache, new ones are scanned in the background
+    thumbnailCache.request (url, formatManager,
+                            [safeThis = SafePointer<DemoThumbnailComp> (this), url] (WaveformThumbnailCache::Pyramid result)
     {
-        thumbnail.setSource (inputSource);
+        if (safeThis == nullptr || safeThis->waveformURL != url)
+            return;
         
-        Range<double> newRange (0.0, thumbnail.getTotalLength());
-        scrollbar.setRangeLimits (newRange);
-        setRange (newRange);
+        safeThis->waveform = std::move (result);
         
-        startTimerHz (40);
-    }
+        Range<double> newRange (0.0, safeThis->getTotalLength());
+        safeThis->scrollbar.setRangeLimits (newRange);
+        safeThis->setRange (newRange);
+    });
+    
+    startTimerHz (40);
 }
 
 URL DemoThumbnailComp::getLastDroppedFile() const noexcept { return lastFileDropped; }
 
 void DemoThumbnailComp::setZoomFactor (double amount)
 {
-    if (thumbnail.getTotalLength() > 0)
+    if (getTotalLength() > 0)
     {
-        auto newScale = jmax (0.001, thumbnail.getTotalLength() * (1.0 - jlimit (0.0, 0.99, amount)));
+        auto newScale = jmax (0.001, getTotalLength() * (1.0 - jlimit (0.0, 0.99, amount)));
         auto timeAtCentre = xToTime ((float) getWidth() / 2.0f);
         
         setRange ({ timeAtCentre - newScale * 0.5, timeAtCentre + newScale * 0.5 });
@@ -92,30 +84,51 @@ void DemoThumbnailComp::paint (Graphics& g)
     g.fillAll (Colours::darkgrey);
     g.setColour (Colours::lightblue);
     
-    if (thumbnail.getTotalLength() > 0.0)
+    if (getTotalLength() > 0.0)
     {
         auto thumbArea = getLocalBounds();
         
         thumbArea.removeFromBottom (scrollbar.getHeight() + 4);
-        thumbnail.drawChannels (g, thumbArea.reduced (2),
-                                visibleRange.getStart(), visibleRange.getEnd(), 1.0f);
+        drawWaveform (g, thumbArea.reduced (2));
     }
     else
     {
         g.setFont (14.0f);
-        g.drawFittedText ("(No audio file selected)", getLocalBounds(), Justification::centred, 2);
+        g.drawFittedText (waveformURL.isEmpty() ? "(No audio file selected)" : "(Loading waveform...)",
+                          getLocalBounds(), Justification::centred, 2);
     }
 }
 
-void DemoThumbnailComp::resized()
+void DemoThumbnailComp::drawWaveform (Graphics& g, Rectangle<int> area) const
 {
-    scrollbar.setBounds (getLocalBounds().removeFromBottom (14).reduced (2));
+    const auto& w = *waveform;
+    const auto samplesPerPixel = visibleRange.getLength() * w.sampleRate / jmax (1, area.getWidth());
+    const auto& level = w.getLevelFor (samplesPerPixel);
+    const auto laneHeight = (float) area.getHeight() / (float) w.numChannels;
+    
+    RectangleList<float> bars;
+    
+    for (int ch = 0; ch < w.numChannels; ++ch)
+    {
+        const auto centre = (float) area.getY() + laneHeight * ((float) ch + 0.5f);
+        
+        for (int x = 0; x < area.getWidth(); ++x)
+        {
+            const auto start = visibleRange.getStart() * w.sampleRate + x * samplesPerPixel;
+            const auto range = w.getMinMax (level, ch, (juce::int64) start, (juce::int64) (start + samplesPerPixel));
+            
+            const auto top = centre - range.getEnd() * laneHeight * 0.5f;
+            const auto bottom = centre - range.getStart() * laneHeight * 0.5f;
+            bars.addWithoutMerging ({ (float) (area.getX() + x), top, 1.0f, jmax (1.0f, bottom - top) });
+        }
+    }
+    
+    g.fillRectList (bars);
 }
 
-void DemoThumbnailComp::changeListenerCallback (ChangeBroadcaster*)
+void DemoThumbnailComp::resized()
 {
-    // this method is called by the thumbnail when it has changed, so we should repaint it..
-    repaint();
+    scrollbar.setBounds (getLocalBounds().removeFromBottom (14).reduced (2));
 }
 
 bool DemoThumbnailComp::isInterestedInFileDrag (const StringArray& /*files*/)
@@ -147,10 +160,10 @@ void DemoThumbnailComp::mouseUp (const MouseEvent&)
 
 void DemoThumbnailComp::mouseWheelMove (const MouseEvent&, const MouseWheelDetails& wheel)
 {
-    if (thumbnail.getTotalLength() > 0.0)
+    if (getTotalLength() > 0.0)
     {
         auto newStart = visibleRange.getStart() - wheel.deltaX * (visibleRange.getLength()) / 10.0;
-        newStart = jlimit (0.0, jmax (0.0, thumbnail.getTotalLength() - (visibleRange.getLength())), newStart);
+        newStart = jlimit (0.0, jmax (0.0, getTotalLength() - (visibleRange.getLength())), newStart);
         
         if (canMoveTransport())
             setRange ({ newStart, newStart + visibleRange.getLength() });
@@ -162,6 +175,11 @@ void DemoThumbnailComp::mouseWheelMove (const MouseEvent&, const MouseWheelDetai
     }
 }
 
+double DemoThumbnailComp::getTotalLength() const noexcept
+{
+    return waveform != nullptr ? waveform->getLengthInSeconds() : 0.0;
+}
+
 float DemoThumbnailComp::timeToX (const double time) const
 {
     if (visibleRange.getLength() <= 0)
@@ -212,9 +230,8 @@ void DemoThumbnailComp::updateCursorPosition()
 //==============================================================================
 AudioFilePlayerAudioProcessorEditor::AudioFilePlayerAudioProcessorEditor(AudioFilePlayerAudioProcessor& p) :
 AudioProcessorEditor (&p),
-audioProcessor (p),
+audioProcessor (p)
 //transportSource(p.transportSource)
-directoryList(nullptr, audioProcessor.directoryScannerBackgroundThread)
 {
     addAndMakeVisible (zoomLabel);
     zoomLabel.setFont (Font (15.00f, Font::plain));
@@ -226,12 +243,18 @@ directoryList(nullptr, audioProcessor.directoryScannerBackgroundThread)
     addAndMakeVisible (followTransportButton);
     followTransportButton.onClick = [this] { updateFollowTransportState(); };
     
-    directoryList.setDirectory (File::getSpecialLocation (File::userHomeDirectory), true, true);
+    addAndMakeVisible (loopButton);
+    addAndMakeVisible (syncToHostButton);
+    loopButton.onClick = [this] { audioProcessor.transportSource.setLooping (loopButton.getToggleState()); };
+    
+    // only files the player can open are listed, matched by extension without opening them
+    fileTreeComp.setFileWildcards (audioProcessor.formatManager.getWildcardForAllFormats());
+    fileTreeComp.setRoot (File::getSpecialLocation (File::userHomeDirectory));
     
     addAndMakeVisible (fileTreeComp);
     
     
-    fileTreeComp.setColour (FileTreeComponent::backgroundColourId, Colours::lightgrey.withAlpha (0.6f));
+    fileTreeComp.setColour (TreeView::backgroundColourId, Colours::lightgrey.withAlpha (0.6f));
     fileTreeComp.addListener (this);
     
     addAndMakeVisible (explanation);
@@ -306,7 +329,10 @@ void AudioFilePlayerAudioProcessorEditor::resized()
     zoomLabel .setBounds (zoom.removeFromLeft (50));
     zoomSlider.setBounds (zoom);
     
-    followTransportButton.setBounds (controls.removeFromTop (25));
+    auto toggles = controls.removeFromTop (25);
+    syncToHostButton     .setBounds (toggles.removeFromRight (110));
+    loopButton           .setBounds (toggles.removeFromRight (70));
+    followTransportButton.setBounds (toggles);
     startStopButton      .setBounds (controls);
     
     r.removeFromBottom (6);
@@ -339,7 +365,11 @@ void AudioFilePlayerAudioProcessorEditor::updateFollowTransportState()
 
 void AudioFilePlayerAudioProcessorEditor::selectionChanged()
 {
-    audioProcessor.transportSourceCreator.requestTransportForURL(URL (fileTreeComp.getSelectedFile()));
+    // cmd/ctrl-click queues the file after the current one instead of replacing it
+    if( ModifierKeys::currentModifiers.isCommandDown() )
+        audioProcessor.appendToPlaylist(URL (fileTreeComp.getSelectedFile()));
+    else
+        audioProcessor.transportSourceCreator.requestTransportForURL(URL (fileTreeComp.getSelectedFile()));
 }
 
 void AudioFilePlayerAudioProcessorEditor::fileClicked (const File&, const MouseEvent&)          {}
@@ -375,12 +405,14 @@ void AudioFilePlayerAudioProcessorEditor::timerCallback()
                 thumbnail->setURL (activeSource->currentAudioFile);
             }
         }
-
-        startStopButton.setEnabled( hasValidSource );
     }
     
+    //while the host drives playback, the button only shows its state
+    const auto syncedToHost = syncToHostButton.getToggleState();
+    startStopButton.setEnabled( activeSource != nullptr && ! syncedToHost );
+    
     //update the startStopButton
-    auto isPlaying = audioProcessor.transportSource.isPlaying();
+    auto isPlaying = audioProcessor.transportIsPlaying.get();
     if( audioProcessor.transportSource.getTotalLength() > 0 )
         startStopButton.setButtonText( ! isPlaying ? "Start" : "Stop" );
     
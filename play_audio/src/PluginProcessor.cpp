@@ -23,11 +23,22 @@ AudioFilePlayerAudioProcessor::AudioFilePlayerAudioProcessor()
 #endif
 {
     formatManager.registerBasicFormats();
-    directoryScannerBackgroundThread.startThread (juce::Thread::Priority::normal);
+    readAheadThread.startThread (juce::Thread::Priority::high);
+
+    const auto& resamplerQuality = Params::GetParamNames().at (Params::Names::Resampler_Quality);
+    transportSourceCreator.parameterChanged (resamplerQuality, apvts.getRawParameterValue (resamplerQuality)->load());
+    apvts.addParameterListener (resamplerQuality, &transportSourceCreator);
+
+    // every file reaches the transport through the playlist
+    transportSource.setSource (&playlist);
+    startTimer (30);
 }
 
 AudioFilePlayerAudioProcessor::~AudioFilePlayerAudioProcessor()
 {
+    stopTimer();
+    apvts.removeParameterListener (Params::GetParamNames().at (Params::Names::Resampler_Quality),
+                                   &transportSourceCreator);
 }
 
 //==============================================================================
@@ -98,6 +109,11 @@ void AudioFilePlayerAudioProcessor::prepareToPlay (double sampleRate, int sample
     // Use this method as the place to do any pre-playback
     // initialisation that you need..
     transportSource.prepareToPlay(samplesPerBlock, sampleRate);
+    transportSourceCreator.setPlaybackSpec (sampleRate, samplesPerBlock);
+
+    // the current file was resampled for another rate: load it again for this one
+    if (activeSource != nullptr && ! juce::approximatelyEqual (activeSource->playbackSampleRate, sampleRate))
+        transportSourceCreator.requestTransportForURL (activeSource->currentAudioFile);
 }
 
 void AudioFilePlayerAudioProcessor::releaseResources()
@@ -135,6 +151,8 @@ bool AudioFilePlayerAudioProcessor::isBusesLayoutSupported (const BusesLayout& l
 void AudioFilePlayerAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
 {
     juce::ScopedNoDenormals noDenormals;
+    // nothing handed to the pool is freed while this block still uses it
+    ReleasePool<ReferencedTransportSourceData>::ScopedReader poolReader (pool);
     auto totalNumInputChannels  = getTotalNumInputChannels();
     auto totalNumOutputChannels = getTotalNumOutputChannels();
 
@@ -147,26 +165,172 @@ void AudioFilePlayerAudioProcessor::processBlock (juce::AudioBuffer<float>& buff
     for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
         buffer.clear (i, 0, buffer.getNumSamples());
     
+    // every source is handed to the playlist in order: replacements, appended files and loop partners
     ReferencedTransportSourceData::Ptr ptr;
     while( fifo.pull(ptr) )
     {
-        ;
+        playlist.receive(ptr, transportIsPlaying.get());
     }
+    ptr = nullptr;
+    
+    updatePlaylistSettings();
+    playlist.setClockIsExternal (syncToHost->load() > 0.5f);
+    
+    AudioSourceChannelInfo asci(&buffer, 0, buffer.getNumSamples());
     
-    if( ptr != nullptr )
+    if( syncToHost->load() > 0.5f )
+    {
+        // the host's transport decides; the transport source's own start/stop is ignored
+        const auto hostIsPlaying = followHostTransport (buffer.getNumSamples());
+        
+        if( hostIsPlaying || hostWasPlaying )
+        {
+            playlist.getNextAudioBlock(asci);
+            
+            // the host has just stopped: fade this last block out rather than cut it
+            if( ! hostIsPlaying )
+                buffer.applyGainRamp (0, buffer.getNumSamples(), 1.0f, 0.0f);
+        }
+        else
+        {
+            buffer.clear();
+        }
+        
+        hostWasPlaying = hostIsPlaying;
+        transportIsPlaying.set(hostIsPlaying);
+    }
+    else
+    {
+        hostWasPlaying = false;
+        transportSource.getNextAudioBlock(asci);
+        transportIsPlaying.set(transportSource.isPlaying());
+    }
+    
+    // the playlist may have moved on to the next file inside this block
+    if( playlist.getCurrentSource() != activeSource.get() )
     {
         pool.add(activeSource);
-        activeSource = ptr;
-        transportSource.stop();
-        transportSource.setSource(activeSource->currentAudioFileSource.get(),
-                                  32768,
-                                  &directoryScannerBackgroundThread,
-                                  activeSource->audioFileSourceSampleRate);
+        activeSource = playlist.getCurrent();
+        nowPlayingFifo.push(activeSource);
         sourceHasChanged.set(true);
     }
+}
+
+bool AudioFilePlayerAudioProcessor::followHostTransport (int numSamples)
+{
+    auto* playHead = getPlayHead();
     
-    AudioSourceChannelInfo asci(&buffer, 0, buffer.getNumSamples());
-    transportSource.getNextAudioBlock(asci);
+    if( playHead == nullptr )
+        return false;
+    
+    const auto position = playHead->getPosition();
+    
+    if( ! position.hasValue() || ! position->getIsPlaying() )
+        return false;
+    
+    juce::int64 hostSample = 0;
+    
+    if( const auto samples = position->getTimeInSamples() )
+        hostSample = *samples;
+    else if( const auto seconds = position->getTimeInSeconds() )
+        hostSample = (juce::int64) std::llround (*seconds * getSampleRate());
+    
+    // pre-roll before the start of the file: stay silent and seek again once the host gets there
+    if( hostSample < 0 )
+    {
+        expectedHostSample = -1;
+        return false;
+    }
+    
+    // starting, relocating and wrapping round a host loop all show up as a jump in the host's time
+    if( ! hostWasPlaying || hostSample != expectedHostSample )
+        playlist.setNextReadPosition (hostSample);
+    
+    expectedHostSample = hostSample + numSamples;
+    return true;
+}
+
+void AudioFilePlayerAudioProcessor::setNonRealtime (bool isNonRealtime) noexcept
+{
+    AudioProcessor::setNonRealtime (isNonRealtime);
+    playlist.setWaitsForReadAhead (isNonRealtime);
+}
+
+//==============================================================================
+void AudioFilePlayerAudioProcessor::appendToPlaylist (const juce::URL& url)
+{
+    transportSourceCreator.appendToPlaylist (url);
+}
+
+void AudioFilePlayerAudioProcessor::updatePlaylistSettings()
+{
+    // files are resampled to the host rate before they reach the playlist
+    const auto sampleRate = getSampleRate();
+    
+    playlist.setCrossfadeLength (juce::roundToInt (crossfadeSeconds->load() * sampleRate));
+    
+    // a region is only set while the end lies after the start; otherwise the Loop button loops the whole file
+    const auto loopStart = loopStartSeconds->load();
+    const auto loopEnd = loopEndSeconds->load();
+    
+    if( loopEnd > loopStart )
+        playlist.setLoopRegion ((juce::int64) (loopStart * sampleRate), (juce::int64) (loopEnd * sampleRate));
+    else
+        playlist.clearLoopRegion();
+}
+
+void AudioFilePlayerAudioProcessor::timerCallback()
+{
+    ReferencedTransportSourceData::Ptr ptr;
+    while( nowPlayingFifo.pull(ptr) )
+    {
+        nowPlaying = ptr != nullptr ? ptr->currentAudioFile : juce::URL();
+    }
+    
+    // the playlist is silent until an instance already buffered at the seek target arrives
+    if( const auto seekTarget = playlist.takeSeekRequest(); seekTarget >= 0 && ! nowPlaying.isEmpty() )
+        transportSourceCreator.requestSeek (nowPlaying, seekTarget);
+
+    transportSourceCreator.publishPendingSeek();
+    
+    updateLoopPartner();
+    updateCacheBudgets();
+}
+
+void AudioFilePlayerAudioProcessor::updateCacheBudgets()
+{
+    // applied here rather than from a parameter listener, which may be called on the audio thread
+    const auto& paramNames = Params::GetParamNames();
+    const auto decodeIndex = juce::roundToInt (apvts.getRawParameterValue (paramNames.at (Params::Names::Decode_Cache_Size))->load());
+    const auto headIndex = juce::roundToInt (apvts.getRawParameterValue (paramNames.at (Params::Names::Head_Cache_Size))->load());
+    
+    if( decodeIndex != decodeCacheSizeIndex )
+    {
+        decodeCacheSizeIndex = decodeIndex;
+        transportSourceCreator.setDecodeCacheBudget ((size_t) 128 * 1024 * 1024 << decodeIndex);
+    }
+    
+    if( headIndex != headCacheSizeIndex )
+    {
+        headCacheSizeIndex = headIndex;
+        transportSourceCreator.setHeadCacheBudget ((size_t) 16 * 1024 * 1024 << headIndex);
+    }
+}
+
+void AudioFilePlayerAudioProcessor::updateLoopPartner()
+{
+    const auto loopStart = playlist.getLoopStart();
+    
+    if( loopStart < 0 || nowPlaying.isEmpty() )
+        return;
+    
+    // one partner per file and loop start; after each jump the playlist reuses the instance it left
+    if( nowPlaying == loopPartnerRequestedFor && loopStart == loopPartnerRequestedAt )
+        return;
+    
+    loopPartnerRequestedFor = nowPlaying;
+    loopPartnerRequestedAt = loopStart;
+    transportSourceCreator.requestLoopPartner (nowPlaying, loopStart);
 }
 
 //==============================================================================
@@ -222,8 +386,39 @@ AudioProcessorValueTreeState::ParameterLayout AudioFilePlayerAudioProcessor::cre
     AudioProcessorValueTreeState::ParameterLayout layout;
     
     using namespace Params;
-//    const auto& paramNames = GetParamNames();
-    
+    const auto& paramNames = GetParamNames();
+
+    layout.add (std::make_unique<AudioParameterChoice> (paramNames.at (Names::Resampler_Quality),
+                                                        paramNames.at (Names::Resampler_Quality),
+                                                        StringArray { "Fast", "Normal", "Best" },
+                                                        static_cast<int> (ResamplerQuality::normal)));
+    layout.add (std::make_unique<AudioParameterBool> (paramNames.at (Names::Sync_To_Host),
+                                                      paramNames.at (Names::Sync_To_Host),
+                                                      false));
+    // how much decoded audio the players in this process keep in memory; 512 MB by default
+    layout.add (std::make_unique<AudioParameterChoice> (paramNames.at (Names::Decode_Cache_Size),
+                                                        paramNames.at (Names::Decode_Cache_Size),
+                                                        StringArray { "128 MB", "256 MB", "512 MB", "1 GB", "2 GB" },
+                                                        2));
+    // how much of the start of recently played files is kept ready to play; 64 MB by default
+    layout.add (std::make_unique<AudioParameterChoice> (paramNames.at (Names::Head_Cache_Size),
+                                                        paramNames.at (Names::Head_Cache_Size),
+                                                        StringArray { "16 MB", "32 MB", "64 MB", "128 MB", "256 MB" },
+                                                        2));
+    // in seconds; the loop region also needs the Loop button (or the host's loop) to be on
+    layout.add (std::make_unique<AudioParameterFloat> (paramNames.at (Names::Crossfade),
+                                                       paramNames.at (Names::Crossfade),
+                                                       NormalisableRange<float> (0.f, 5.f, 0.001f, 0.5f),
+                                                       0.f));
+    layout.add (std::make_unique<AudioParameterFloat> (paramNames.at (Names::Loop_Start),
+                                                       paramNames.at (Names::Loop_Start),
+                                                       NormalisableRange<float> (0.f, 3600.f, 0.001f, 0.3f),
+                                                       0.f));
+    layout.add (std::make_unique<AudioParameterFloat> (paramNames.at (Names::Loop_End),
+                                                       paramNames.at (Names::Loop_End),
+                                                       NormalisableRange<float> (0.f, 3600.f, 0.001f, 0.3f),
+                                                       0.f));
+
     return layout;
 }
 //==============================================================================
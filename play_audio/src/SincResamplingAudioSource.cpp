@@ -0,0 +1,314 @@
+#include "SincResamplingAudioSource.h"
+
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    struct QualitySpec
+    {
+        int numTaps;
+        double beta;      // Kaiser window shape: stop-band rejection against transition width
+        double passband;  // fraction of the lower Nyquist frequency that is kept
+    };
+
+    QualitySpec getSpec (ResamplerQuality quality)
+    {
+        switch (quality)
+        {
+            case ResamplerQuality::fast:   return { 16, 6.0, 0.90 };
+            case ResamplerQuality::best:   return { 64, 10.0, 0.97 };
+            case ResamplerQuality::normal: break;
+        }
+
+        return { 32, 8.0, 0.95 };
+    }
+
+    double sinc (double x)
+    {
+        if (x == 0.0)
+            return 1.0;
+
+        const auto px = juce::MathConstants<double>::pi * x;
+        return std::sin (px) / px;
+    }
+
+    double besselI0 (double x)
+    {
+        double sum = 1.0, term = 1.0;
+
+        for (int k = 1; k < 50 && term > sum * 1.0e-12; ++k)
+        {
+            const auto f = x / (2.0 * k);
+            term *= f * f;
+            sum += term;
+        }
+
+        return sum;
+    }
+
+    // r runs from -1 to 1 across the window
+    double kaiser (double r, double beta)
+    {
+        if (std::abs (r) >= 1.0)
+            return 0.0;
+
+        return besselI0 (beta * std::sqrt (1.0 - r * r)) / besselI0 (beta);
+    }
+
+    float* alignToRegister (float* p)
+    {
+       #if JUCE_USE_SIMD
+        return juce::dsp::SIMDRegister<float>::getNextSIMDAlignedPtr (p);
+       #else
+        return p;
+       #endif
+    }
+}
+
+//==============================================================================
+SincResamplingAudioSource::SincResamplingAudioSource (juce::PositionableAudioSource& source,
+                                                      double inputSampleRate,
+                                                      double outputSampleRate,
+                                                      ResamplerQuality quality)
+    : input (source),
+      inputRate (inputSampleRate),
+      ratio (inputSampleRate / outputSampleRate),
+      numTaps (getSpec (quality).numTaps),
+      halfTaps (numTaps / 2)
+{
+    const auto spec = getSpec (quality);
+
+    // when downsampling, the cut-off has to move down to the new Nyquist frequency
+    buildPhaseTable (spec.passband * juce::jmin (1.0, 1.0 / ratio), spec.beta);
+
+    // a full window plus one chunk; the padding lets a table row read past the last tap
+    historyCapacity = numTaps + inputChunkSize + 2 * framesPerVec;
+    historyStorage.assign ((size_t) (2 * (historyCapacity + 2 * framesPerVec) + floatsPerVec), 0.0f);
+    history = alignToRegister (historyStorage.data());
+
+    inputBlock.setSize (2, inputChunkSize);
+}
+
+void SincResamplingAudioSource::buildPhaseTable (double cutoff, double beta)
+{
+    // each row is stored once for every offset a window can have within a register,
+    // so the samples can always be loaded from an aligned address
+    const auto paddedFrames = (numTaps + 2 * (framesPerVec - 1)) / framesPerVec * framesPerVec;
+    rowSize = 2 * paddedFrames;
+
+    const auto numRows = (numPhases + 1) * framesPerVec;
+    tableStorage.assign ((size_t) (numRows * rowSize + floatsPerVec), 0.0f);
+    table = alignToRegister (tableStorage.data());
+
+    std::vector<double> coefficients ((size_t) numTaps);
+
+    for (int phase = 0; phase <= numPhases; ++phase)
+    {
+        const auto fraction = (double) phase / numPhases;
+        double sum = 0.0;
+
+        for (int k = 0; k < numTaps; ++k)
+        {
+            // distance of this tap from the interpolated position, in input samples
+            const auto x = (double) (k - halfTaps + 1) - fraction;
+            coefficients[(size_t) k] = cutoff * sinc (cutoff * x) * kaiser (x / halfTaps, beta);
+            sum += coefficients[(size_t) k];
+        }
+
+        for (int offset = 0; offset < framesPerVec; ++offset)
+        {
+            auto* row = table + (phase * framesPerVec + offset) * rowSize;
+
+            for (int k = 0; k < numTaps; ++k)
+            {
+                const auto c = (float) (coefficients[(size_t) k] / sum);
+                row[2 * (k + offset)]     = c;
+                row[2 * (k + offset) + 1] = c;
+            }
+        }
+    }
+}
+
+//==============================================================================
+void SincResamplingAudioSource::prepareToPlay (int, double)
+{
+    input.prepareToPlay (inputChunkSize, inputRate);
+}
+
+void SincResamplingAudioSource::releaseResources()
+{
+    input.releaseResources();
+}
+
+void SincResamplingAudioSource::resetHistory()
+{
+    const auto firstFrame = (juce::int64) std::floor ((double) position * ratio) - halfTaps + 1;
+
+    historyStart = firstFrame;
+    historyFrames = 0;
+
+    // the window reaches back past the start of the input: that part is silence
+    if (firstFrame < 0)
+    {
+        historyFrames = (int) -firstFrame;
+        std::fill (history, history + 2 * historyFrames, 0.0f);
+    }
+
+    input.setNextReadPosition (juce::jmax ((juce::int64) 0, firstFrame));
+    needsReset = false;
+}
+
+void SincResamplingAudioSource::pullInput (juce::int64 firstFrameNeeded, juce::int64 endFrameNeeded)
+{
+    while (historyStart + historyFrames < endFrameNeeded)
+    {
+        // make room by dropping the frames no window needs any more
+        if (historyFrames + inputChunkSize > historyCapacity - framesPerVec)
+        {
+            const auto drop = (int) juce::jlimit ((juce::int64) 0, (juce::int64) historyFrames,
+                                                  firstFrameNeeded - historyStart);
+
+            std::memmove (history, history + 2 * drop, sizeof (float) * (size_t) (2 * (historyFrames - drop)));
+            historyStart += drop;
+            historyFrames -= drop;
+        }
+
+        const auto numToRead = juce::jmin (inputChunkSize, historyCapacity - framesPerVec - historyFrames);
+        jassert (numToRead > 0);
+
+        input.getNextAudioBlock (juce::AudioSourceChannelInfo (&inputBlock, 0, numToRead));
+
+        auto* dest = history + 2 * historyFrames;
+        const auto* left  = inputBlock.getReadPointer (0);
+        const auto* right = inputBlock.getReadPointer (1);
+
+        for (int i = 0; i < numToRead; ++i)
+        {
+            dest[2 * i]     = left[i];
+            dest[2 * i + 1] = right[i];
+        }
+
+        historyFrames += numToRead;
+    }
+}
+
+void SincResamplingAudioSource::interpolate (double inputTime, float& left, float& right) const
+{
+    const auto frame = (juce::int64) std::floor (inputTime);
+    const auto phasePosition = (inputTime - (double) frame) * numPhases;
+    const auto phase = juce::jmin (numPhases - 1, (int) phasePosition);
+    const auto phaseFraction = (float) (phasePosition - phase);
+
+    const auto start = (int) (frame - halfTaps + 1 - historyStart);
+    const auto offset = start % framesPerVec;
+
+    const auto* samples = history + 2 * (start - offset);
+    const auto* row0 = table + (phase * framesPerVec + offset) * rowSize;
+    const auto* row1 = row0 + framesPerVec * rowSize;
+
+   #if JUCE_USE_SIMD
+    auto acc0 = Vec::expand (0.0f);
+    auto acc1 = Vec::expand (0.0f);
+
+    for (int i = 0; i < rowSize; i += floatsPerVec)
+    {
+        const auto x = Vec::fromRawArray (samples + i);
+        acc0 += x * Vec::fromRawArray (row0 + i);
+        acc1 += x * Vec::fromRawArray (row1 + i);
+    }
+
+    alignas (Vec::SIMDRegisterSize) float sums0[floatsPerVec];
+    alignas (Vec::SIMDRegisterSize) float sums1[floatsPerVec];
+    acc0.copyToRawArray (sums0);
+    acc1.copyToRawArray (sums1);
+   #else
+    float sums0[floatsPerVec] = {};
+    float sums1[floatsPerVec] = {};
+
+    for (int i = 0; i < rowSize; i += floatsPerVec)
+    {
+        for (int lane = 0; lane < floatsPerVec; ++lane)
+        {
+            sums0[lane] += samples[i + lane] * row0[i + lane];
+            sums1[lane] += samples[i + lane] * row1[i + lane];
+        }
+    }
+   #endif
+
+    // even lanes hold the left channel, odd lanes the right one
+    float left0 = 0, right0 = 0, left1 = 0, right1 = 0;
+
+    for (int lane = 0; lane < floatsPerVec; lane += 2)
+    {
+        left0  += sums0[lane];
+        right0 += sums0[lane + 1];
+        left1  += sums1[lane];
+        right1 += sums1[lane + 1];
+    }
+
+    left  = left0  + phaseFraction * (left1  - left0);
+    right = right0 + phaseFraction * (right1 - right0);
+}
+
+void SincResamplingAudioSource::getNextAudioBlock (const juce::AudioSourceChannelInfo& info)
+{
+    if (needsReset)
+        resetHistory();
+
+    auto& buffer = *info.buffer;
+    auto* outLeft  = buffer.getWritePointer (0, info.startSample);
+    auto* outRight = buffer.getNumChannels() > 1 ? buffer.getWritePointer (1, info.startSample) : nullptr;
+
+    for (int i = 0; i < info.numSamples; ++i)
+    {
+        const auto inputTime = (double) (position + i) * ratio;
+        const auto frame = (juce::int64) std::floor (inputTime);
+
+        pullInput (frame - halfTaps + 1, frame + halfTaps + 1);
+
+        float left, right;
+        interpolate (inputTime, left, right);
+
+        outLeft[i] = left;
+
+        if (outRight != nullptr)
+            outRight[i] = right;
+    }
+
+    for (int ch = 2; ch < buffer.getNumChannels(); ++ch)
+        buffer.clear (ch, info.startSample, info.numSamples);
+
+    position += info.numSamples;
+}
+
+//==============================================================================
+void SincResamplingAudioSource::setNextReadPosition (juce::int64 newPosition)
+{
+    if (newPosition != getNextReadPosition())
+    {
+        position = newPosition;
+        needsReset = true;
+    }
+}
+
+juce::int64 SincResamplingAudioSource::getNextReadPosition() const
+{
+    const auto length = getTotalLength();
+    return isLooping() && length > 0 ? position % length : position;
+}
+
+juce::int64 SincResamplingAudioSource::getTotalLength() const
+{
+    return (juce::int64) ((double) input.getTotalLength() / ratio);
+}
+
+bool SincResamplingAudioSource::isLooping() const
+{
+    return input.isLooping();
+}
+
+void SincResamplingAudioSource::setLooping (bool shouldLoop)
+{
+    input.setLooping (shouldLoop);
+}
@@ -7,4 +7,28 @@ TEST(EQ_Plagin, Foo) {
   ASSERT_FALSE(true);
 }
 
+TEST(MultiChannelSampleFifo, PublishesABlockAsSoonAsItIsFull) {
+  MultiChannelSampleFifo<juce::AudioBuffer<float>> fifo;
+  fifo.prepare(2, 64);
+
+  juce::AudioBuffer<float> input(2, 32);
+  for (int i = 0; i < 32; ++i) {
+    input.setSample(0, i, (float)i);
+    input.setSample(1, i, (float)-i);
+  }
+
+  fifo.update(input);
+  EXPECT_EQ(fifo.getNumCompleteBuffersAvailable(), 0);
+
+  fifo.update(input);
+  ASSERT_EQ(fifo.getNumCompleteBuffersAvailable(), 1);
+
+  juce::AudioBuffer<float> block;
+  ASSERT_TRUE(fifo.getAudioBuffer(block));
+  ASSERT_EQ(block.getNumChannels(), 2);
+  ASSERT_EQ(block.getNumSamples(), 64);
+  EXPECT_EQ(block.getSample(0, 63), 31.f);
+  EXPECT_EQ(block.getSample(1, 40), -8.f);
+}
+
 }  // namespace eq_plagin_test
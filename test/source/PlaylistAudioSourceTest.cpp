@@ -0,0 +1,209 @@
+#include <gtest/gtest.h>
+#include "PluginProcessor.h"
+
+#include <cmath>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace play_audio_test {
+class PlaylistAudioSourceTest : public ::testing::Test {
+ protected:
+  using Ptr = ReferencedTransportSourceData::Ptr;
+  using Role = ReferencedTransportSourceData::Role;
+
+  static constexpr int blockSize = 32;
+
+  void SetUp() override {
+    juce::MessageManager::getInstance();
+    pool = std::make_unique<ReleasePool<ReferencedTransportSourceData>>();
+    playlist = std::make_unique<PlaylistAudioSource>(*pool);
+    playlist->prepareToPlay(blockSize, 48000.0);
+  }
+
+  void TearDown() override {
+    playlist.reset();
+    pool.reset();
+    juce::MessageManager::deleteInstance();
+  }
+
+  // a file of the given length whose samples are sampleAt(index) on both channels
+  Ptr makeSource(int length, const std::function<float(int)>& sampleAt, Role role,
+                 const juce::String& name = "a.wav") {
+    auto& buffer = buffers.emplace_back(std::make_unique<juce::AudioBuffer<float>>(2, length));
+
+    for (int i = 0; i < length; ++i) {
+      buffer->setSample(0, i, sampleAt(i));
+      buffer->setSample(1, i, sampleAt(i));
+    }
+
+    auto& source = sources.emplace_back(std::make_unique<juce::MemoryAudioSource>(*buffer, false));
+
+    Ptr rts = new ReferencedTransportSourceData();
+    rts->role = role;
+    rts->currentAudioFile = juce::URL(juce::File::getCurrentWorkingDirectory().getChildFile(name));
+    rts->playbackSampleRate = 48000.0;
+    // no cached head, so everything is read from the source itself
+    rts->playbackSource = std::make_unique<HeadCachedAudioSource>(
+        std::make_shared<juce::AudioBuffer<float>>(2, 0), *source);
+    return rts;
+  }
+
+  // plays numSamples in blocks that do not line up with any of the transitions
+  std::vector<float> render(int numSamples) {
+    std::vector<float> output;
+    juce::AudioBuffer<float> block(2, blockSize);
+
+    while (static_cast<int>(output.size()) < numSamples) {
+      const auto n = juce::jmin(blockSize, numSamples - static_cast<int>(output.size()));
+      block.clear();
+      playlist->getNextAudioBlock(juce::AudioSourceChannelInfo(&block, 0, n));
+
+      for (int i = 0; i < n; ++i) output.push_back(block.getSample(0, i));
+    }
+
+    return output;
+  }
+
+  // the sources are declared first, so they outlive everything in the pool that reads them
+  std::vector<std::unique_ptr<juce::AudioBuffer<float>>> buffers;
+  std::vector<std::unique_ptr<juce::MemoryAudioSource>> sources;
+  std::unique_ptr<ReleasePool<ReferencedTransportSourceData>> pool;
+  std::unique_ptr<PlaylistAudioSource> playlist;
+};
+
+TEST_F(PlaylistAudioSourceTest, AppendedFilesFollowWithoutAGap) {
+  playlist->receive(makeSource(100, [](int i) { return 1.f + (float)i; }, Role::replace), false);
+  playlist->receive(
+      makeSource(70, [](int i) { return 1000.f + (float)i; }, Role::append, "b.wav"), false);
+
+  const auto output = render(200);
+
+  for (int i = 0; i < 100; ++i) ASSERT_EQ(output[(size_t)i], 1.f + (float)i) << i;
+
+  for (int i = 0; i < 70; ++i) ASSERT_EQ(output[(size_t)(100 + i)], 1000.f + (float)i) << i;
+
+  for (int i = 170; i < 200; ++i) ASSERT_EQ(output[(size_t)i], 0.f) << i;
+}
+
+TEST_F(PlaylistAudioSourceTest, CrossfadeOverlapsTheEndOfTheCurrentFile) {
+  constexpr int fade = 20;
+  playlist->setCrossfadeLength(fade);
+  playlist->receive(makeSource(100, [](int) { return 1.f; }, Role::replace), false);
+  playlist->receive(makeSource(100, [](int) { return 0.5f; }, Role::append, "b.wav"), false);
+
+  const auto output = render(220);
+
+  for (int i = 0; i < 100 - fade; ++i) ASSERT_EQ(output[(size_t)i], 1.f) << i;
+
+  // the outgoing file fades from 1 to 0 over the fade while the next one fades in
+  for (int i = 0; i < fade; ++i) {
+    const auto gainOut = 1.f - (float)i / (float)fade;
+    EXPECT_NEAR(output[(size_t)(100 - fade + i)], gainOut + 0.5f * (1.f - gainOut), 1.0e-5f) << i;
+  }
+
+  // the second file started fade samples early, so it also ends fade samples early
+  for (int i = 100; i < 200 - fade; ++i) ASSERT_EQ(output[(size_t)i], 0.5f) << i;
+
+  for (int i = 200 - fade; i < 220; ++i) ASSERT_EQ(output[(size_t)i], 0.f) << i;
+}
+
+TEST_F(PlaylistAudioSourceTest, LoopWrapsOnTheExactSample) {
+  // without a loop partner the loop is not crossfaded, so the fade must not shorten it either
+  playlist->setCrossfadeLength(8);
+  playlist->setLoopRegion(10, 50);
+  playlist->receive(makeSource(100, [](int i) { return 1.f + (float)i; }, Role::replace), false);
+
+  const auto output = render(300);
+
+  for (int i = 0; i < 50; ++i) ASSERT_EQ(output[(size_t)i], 1.f + (float)i) << i;
+
+  for (int i = 50; i < 300; ++i)
+    ASSERT_EQ(output[(size_t)i], 1.f + (float)(10 + (i - 50) % 40)) << i;
+}
+
+TEST_F(PlaylistAudioSourceTest, LoopPartnerWrapsOnTheExactSample) {
+  playlist->setLoopRegion(10, 50);
+  playlist->receive(makeSource(100, [](int i) { return 1.f + (float)i; }, Role::replace), false);
+
+  auto partner = makeSource(100, [](int i) { return 1.f + (float)i; }, Role::loopPartner);
+  partner->playbackSource->setNextReadPosition(10);
+  playlist->receive(partner, false);
+
+  const auto output = render(300);
+
+  for (int i = 0; i < 50; ++i) ASSERT_EQ(output[(size_t)i], 1.f + (float)i) << i;
+
+  for (int i = 50; i < 300; ++i)
+    ASSERT_EQ(output[(size_t)i], 1.f + (float)(10 + (i - 50) % 40)) << i;
+}
+
+TEST_F(PlaylistAudioSourceTest, LoopWithAPartnerIsCrossfaded) {
+  constexpr int fade = 8;
+  playlist->setCrossfadeLength(fade);
+  playlist->setLoopRegion(10, 50);
+  playlist->receive(makeSource(100, [](int) { return 1.f; }, Role::replace), false);
+  playlist->receive(makeSource(100, [](int) { return 1.f; }, Role::loopPartner), false);
+
+  // both instances play the same constant, so the crossfade keeps the level where it is
+  const auto output = render(300);
+
+  for (int i = 0; i < 300; ++i) ASSERT_NEAR(output[(size_t)i], 1.f, 1.0e-5f) << i;
+}
+
+TEST_F(PlaylistAudioSourceTest, SeekResumesOnceAnInstanceAtTheTargetArrives) {
+  constexpr int fade = PlaylistAudioSource::replaceFadeSamples;
+  playlist->receive(makeSource(2000, [](int i) { return 1.f + (float)i; }, Role::replace), false);
+  render(100);
+
+  playlist->setNextReadPosition(1000);
+  auto output = render(400);
+
+  // the old position fades out, then nothing plays until the loader has answered
+  EXPECT_EQ(output[0], 101.f);
+  EXPECT_LT(std::abs(output[(size_t)(fade - 1)]), 2.f);
+
+  for (int i = fade; i < 400; ++i) ASSERT_EQ(output[(size_t)i], 0.f) << i;
+
+  ASSERT_EQ(playlist->takeSeekRequest(), 1000);
+  EXPECT_EQ(playlist->takeSeekRequest(), -1);
+
+  auto seeked = makeSource(2000, [](int i) { return 1.f + (float)i; }, Role::seek);
+  seeked->playbackSource->setNextReadPosition(1000);
+  playlist->receive(seeked, false);
+
+  output = render(400);
+
+  for (int i = 0; i < fade; ++i)
+    ASSERT_NEAR(output[(size_t)i], (1001.f + (float)i) * (float)i / (float)fade, 1.0e-2f) << i;
+
+  for (int i = fade; i < 400; ++i) ASSERT_EQ(output[(size_t)i], 1001.f + (float)i) << i;
+}
+
+TEST_F(PlaylistAudioSourceTest, SeekFollowingTheHostStartsWhereItsClockHasGot) {
+  constexpr int fade = PlaylistAudioSource::replaceFadeSamples;
+  constexpr int lead = 12000;  // a quarter of a second at 48 kHz
+  playlist->setClockIsExternal(true);
+  playlist->receive(makeSource(20000, [](int i) { return 1.f + (float)i; }, Role::replace), false);
+  render(100);
+
+  playlist->setNextReadPosition(500);
+  render(1000);
+
+  ASSERT_EQ(playlist->takeSeekRequest(), 500 + lead);
+
+  auto seeked = makeSource(20000, [](int i) { return 1.f + (float)i; }, Role::seek);
+  seeked->playbackSource->setNextReadPosition(500 + lead);
+  playlist->receive(seeked, false);
+
+  // the clock kept running through the first 1000 samples, so the file comes back lead samples
+  // after the seek, at the position the host expects there
+  const auto output = render(lead);
+  const auto resumesAt = lead - 1000;
+
+  for (int i = 0; i < resumesAt; ++i) ASSERT_EQ(output[(size_t)i], 0.f) << i;
+
+  for (int i = resumesAt + fade; i < lead; ++i)
+    ASSERT_EQ(output[(size_t)i], 1.f + (float)(500 + lead + i - resumesAt)) << i;
+}
+}  // namespace play_audio_test
@@ -0,0 +1,147 @@
+#include <gtest/gtest.h>
+#include "ReleasePool.h"
+
+#include <optional>
+#include <thread>
+#include <vector>
+
+namespace play_audio_test {
+struct Tracked : juce::ReferenceCountedObject {
+  using Ptr = juce::ReferenceCountedObjectPtr<Tracked>;
+
+  explicit Tracked(std::atomic<int>& d, std::atomic<int>& off)
+      : deletions(d), deletionsOffMessageThread(off) {}
+
+  ~Tracked() override {
+    ++deletions;
+
+    if (!juce::MessageManager::getInstance()->isThisTheMessageThread())
+      ++deletionsOffMessageThread;
+  }
+
+  std::atomic<int>& deletions;
+  std::atomic<int>& deletionsOffMessageThread;
+};
+
+class ReleasePoolTest : public ::testing::Test {
+ protected:
+  void SetUp() override { juce::MessageManager::getInstance(); }
+  void TearDown() override { juce::MessageManager::deleteInstance(); }
+
+  Tracked::Ptr make() { return new Tracked(deletions, deletionsOffMessageThread); }
+
+  std::atomic<int> deletions{0};
+  std::atomic<int> deletionsOffMessageThread{0};
+};
+
+TEST_F(ReleasePoolTest, KeepsReferencedObjects) {
+  ReleasePool<Tracked> pool;
+  auto object = make();
+
+  pool.add(object);
+  pool.collect();
+  EXPECT_EQ(deletions, 0);
+
+  object = nullptr;
+  pool.collect();
+  EXPECT_EQ(deletions, 1);
+  EXPECT_EQ(pool.getNumRetired(), 0u);
+}
+
+TEST_F(ReleasePoolTest, MergesDuplicates) {
+  ReleasePool<Tracked> pool;
+  auto object = make();
+
+  for (int i = 0; i < 10; ++i) pool.add(object);
+
+  pool.collect();
+  EXPECT_EQ(pool.getNumRetired(), 1u);
+
+  object = nullptr;
+  pool.collect();
+  EXPECT_EQ(deletions, 1);
+  EXPECT_EQ(pool.getNumRetired(), 0u);
+}
+
+TEST_F(ReleasePoolTest, WaitsForTheReaderToLeave) {
+  ReleasePool<Tracked> pool;
+
+  {
+    ReleasePool<Tracked>::ScopedReader reader(pool);
+    auto object = make();
+    pool.add(object);
+    object = nullptr;
+
+    pool.collect();
+    pool.collect();
+    EXPECT_EQ(deletions, 0);
+  }
+
+  pool.collect();
+  EXPECT_EQ(deletions, 1);
+}
+
+TEST_F(ReleasePoolTest, NeverDeletesOnProducerThreads) {
+  constexpr int numProducers = 4;
+  constexpr int objectsPerProducer = 2000;
+
+  // every object is added twice; large enough that no producer can ever find the slots full
+  using Pool = ReleasePool<Tracked, 2 * numProducers * objectsPerProducer>;
+  Pool pool;
+  std::atomic<int> producersDone{0};
+  std::vector<std::thread> producers;
+
+  for (int p = 0; p < numProducers; ++p) {
+    producers.emplace_back([&, p] {
+      for (int i = 0; i < objectsPerProducer; ++i) {
+        // producer 0 behaves like the audio thread, the others like loader workers
+        std::optional<Pool::ScopedReader> reader;
+
+        if (p == 0) reader.emplace(pool);
+
+        auto object = make();
+        pool.add(object);
+        pool.add(object);
+      }
+
+      ++producersDone;
+    });
+  }
+
+  while (producersDone < numProducers) pool.collect();
+
+  for (auto& t : producers) t.join();
+
+  pool.collect();
+
+  EXPECT_EQ(deletions, numProducers * objectsPerProducer);
+  EXPECT_EQ(deletionsOffMessageThread, 0);
+  EXPECT_EQ(pool.getNumOverflows(), 0);
+  EXPECT_EQ(pool.getNumRetired(), 0u);
+}
+
+TEST_F(ReleasePoolTest, OverflowKeepsTheObjectAlive) {
+  ReleasePool<Tracked, 4> pool;
+  std::vector<Tracked*> leaked;
+
+  std::thread producer([&] {
+    for (int i = 0; i < 5; ++i) {
+      auto object = make();
+      leaked.push_back(object.get());
+      pool.add(object);
+    }
+  });
+  producer.join();
+
+  EXPECT_EQ(pool.getNumOverflows(), 1);
+  EXPECT_EQ(deletionsOffMessageThread, 0);
+
+  pool.collect();
+  EXPECT_EQ(deletions, 4);
+
+  // the object that did not fit still holds the pool's reference
+  leaked.back()->decReferenceCount();
+  EXPECT_EQ(deletions, 5);
+}
+
+}  // namespace play_audio_test
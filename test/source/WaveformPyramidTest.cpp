@@ -0,0 +1,133 @@
+#include <gtest/gtest.h>
+#include "WaveformThumbnailCache.h"
+
+namespace play_audio_test {
+class WaveformPyramidTest : public ::testing::Test {
+ protected:
+  static constexpr double sampleRate = 48000.0;
+  static constexpr int numSamples = 200000;
+
+  // a stereo ramp from -1 to 1 on the left and silence on the right
+  std::unique_ptr<juce::AudioFormatReader> makeReader() {
+    juce::AudioBuffer<float> buffer(2, numSamples);
+    buffer.clear();
+
+    for (int i = 0; i < numSamples; ++i)
+      buffer.setSample(0, i, -1.0f + 2.0f * static_cast<float>(i) / (numSamples - 1));
+
+    auto* out = new juce::MemoryOutputStream(wav, false);
+    juce::WavAudioFormat format;
+    std::unique_ptr<juce::AudioFormatWriter> writer(
+        format.createWriterFor(out, sampleRate, 2, 32, {}, 0));
+    writer->writeFromAudioSampleBuffer(buffer, 0, numSamples);
+    writer.reset();
+
+    return std::unique_ptr<juce::AudioFormatReader>(
+        format.createReaderFor(new juce::MemoryInputStream(wav, false), true));
+  }
+
+  static std::unique_ptr<WaveformPyramid> build(juce::AudioFormatReader& reader) {
+    return WaveformPyramid::build(reader, [] { return false; });
+  }
+
+  juce::MemoryBlock wav;
+};
+
+TEST_F(WaveformPyramidTest, BuildsCoarserLevels) {
+  auto reader = makeReader();
+  auto pyramid = build(*reader);
+
+  ASSERT_NE(pyramid, nullptr);
+  EXPECT_EQ(pyramid->lengthInSamples, numSamples);
+  EXPECT_EQ(pyramid->levels.front().samplesPerBin, WaveformPyramid::baseBinSize);
+  EXPECT_LE(pyramid->levels.back().numBins, WaveformPyramid::minBinsPerLevel);
+
+  for (size_t i = 1; i < pyramid->levels.size(); ++i)
+    EXPECT_EQ(pyramid->levels[i].samplesPerBin,
+              pyramid->levels[i - 1].samplesPerBin * WaveformPyramid::levelFactor);
+}
+
+TEST_F(WaveformPyramidTest, PicksTheCoarsestLevelWithABinPerPixel) {
+  auto reader = makeReader();
+  auto pyramid = build(*reader);
+
+  EXPECT_EQ(pyramid->getLevelFor(1.0).samplesPerBin, WaveformPyramid::baseBinSize);
+  EXPECT_EQ(pyramid->getLevelFor(4096.0).samplesPerBin, 2048);
+  EXPECT_EQ(pyramid->getLevelFor(1.0e9).samplesPerBin, pyramid->levels.back().samplesPerBin);
+}
+
+TEST_F(WaveformPyramidTest, EveryLevelCoversTheSameRange) {
+  auto reader = makeReader();
+  auto pyramid = build(*reader);
+
+  for (auto& level : pyramid->levels) {
+    const auto whole = pyramid->getMinMax(level, 0, 0, numSamples);
+    EXPECT_NEAR(whole.getStart(), -1.0f, 0.01f);
+    EXPECT_NEAR(whole.getEnd(), 1.0f, 0.01f);
+
+    const auto silent = pyramid->getMinMax(level, 1, 0, numSamples);
+    EXPECT_NEAR(silent.getStart(), 0.0f, 0.01f);
+    EXPECT_NEAR(silent.getEnd(), 0.0f, 0.01f);
+  }
+
+  // the first half of the ramp stays below zero
+  const auto firstHalf = pyramid->getMinMax(pyramid->levels.front(), 0, 0, numSamples / 2 - 1024);
+  EXPECT_LE(firstHalf.getEnd(), 0.0f);
+}
+
+TEST_F(WaveformPyramidTest, RoundTripsThroughAStream) {
+  auto reader = makeReader();
+  auto pyramid = build(*reader);
+
+  juce::MemoryOutputStream out;
+  pyramid->writeTo(out, "key");
+
+  juce::MemoryInputStream in(out.getData(), out.getDataSize(), false);
+  auto loaded = WaveformPyramid::readFrom(in, "key");
+
+  ASSERT_NE(loaded, nullptr);
+  EXPECT_EQ(loaded->numChannels, pyramid->numChannels);
+  EXPECT_EQ(loaded->lengthInSamples, pyramid->lengthInSamples);
+  ASSERT_EQ(loaded->levels.size(), pyramid->levels.size());
+
+  for (size_t i = 0; i < loaded->levels.size(); ++i)
+    EXPECT_EQ(loaded->levels[i].channels, pyramid->levels[i].channels);
+}
+
+TEST_F(WaveformPyramidTest, RejectsAnotherKeyOrATruncatedStream) {
+  auto reader = makeReader();
+  auto pyramid = build(*reader);
+
+  juce::MemoryOutputStream out;
+  pyramid->writeTo(out, "key");
+
+  juce::MemoryInputStream otherKey(out.getData(), out.getDataSize(), false);
+  EXPECT_EQ(WaveformPyramid::readFrom(otherKey, "other"), nullptr);
+
+  juce::MemoryInputStream truncated(out.getData(), out.getDataSize() / 2, false);
+  EXPECT_EQ(WaveformPyramid::readFrom(truncated, "key"), nullptr);
+}
+
+TEST_F(WaveformPyramidTest, RejectsABinCountLargerThanTheStream) {
+  auto reader = makeReader();
+  auto pyramid = build(*reader);
+
+  juce::MemoryOutputStream out;
+  pyramid->writeTo(out, "key");
+
+  // the first level's bin count follows the header and that level's bin size
+  constexpr size_t numBinsOffset = 4 + 4 + 4 + 4 + 8 + 8 + 4 + 4;
+  const auto* data = static_cast<const char*>(out.getData());
+
+  for (const auto numBins : {0x7fffffff, 0x40000000, -1}) {
+    juce::MemoryOutputStream garbage;
+    garbage.write(data, numBinsOffset);
+    garbage.writeInt(numBins);
+    garbage.write(data + numBinsOffset + 4, out.getDataSize() - numBinsOffset - 4);
+
+    juce::MemoryInputStream in(garbage.getData(), garbage.getDataSize(), false);
+    EXPECT_EQ(WaveformPyramid::readFrom(in, "key"), nullptr) << numBins;
+  }
+}
+
+}  // namespace play_audio_test